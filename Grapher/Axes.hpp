@@ -0,0 +1,68 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+/// Half the length of a tick mark, in pixels.
+inline constexpr float kAxisTickPx = 4;
+
+inline static float getNiceStep(float range) {
+  float rough = range / 10.0f;
+  float scale = std::pow(10.0f, std::floor(std::log10(rough)));
+  float normalized = rough / scale;
+
+  if (normalized < 1.5f)
+    return scale;
+  if (normalized < 3.0f)
+    return scale * 2.0f;
+  if (normalized < 7.0f)
+    return scale * 5.0f;
+  return scale * 10.0f;
+}
+
+static inline std::string formatNumber(float value) {
+  if (std::abs(value) < 1e-10)
+    return "0";
+  if (std::abs(value) >= 10000 || std::abs(value) < 0.01) {
+    return fmt::format("{:.1e}", value);
+  }
+  return fmt::format("{:.2g}", value);
+}
+
+/**
+ * @brief Where the grid lines of a view fall, in view coordinates.
+ */
+struct AxisLayout {
+  float xStep{};
+  float yStep{};
+  std::vector<float> xs{}; ///< Vertical grid lines, left to right
+  std::vector<float> ys{}; ///< Horizontal grid lines, top to bottom
+};
+
+/**
+ * @brief Lays a grid of `getNiceStep()` spacing over a view.
+ *
+ * Lines start at the multiple of the step at or before the low edge and
+ * are stepped in float, as `AxisSystem` steps them, so both place the
+ * same lines.
+ */
+inline AxisLayout layoutAxes(float xMin, float xMax, float yMin, float yMax) {
+  auto lines = [](float min, float max, float step, std::vector<float> &out) {
+    if (!(step > 0) || !std::isfinite(min) || !std::isfinite(max))
+      return;
+    for (float at = std::floor(min / step) * step; at <= max; at += step) {
+      // Far enough out, adding the step no longer moves `at`.
+      if (!out.empty() && at <= out.back())
+        return;
+      out.push_back(at);
+    }
+  };
+  AxisLayout layout{};
+  layout.xStep = getNiceStep(xMax - xMin);
+  layout.yStep = getNiceStep(yMax - yMin);
+  lines(xMin, xMax, layout.xStep, layout.xs);
+  lines(yMin, yMax, layout.yStep, layout.ys);
+  return layout;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "../functionParser/CompiledExpression.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Sampling {
+
+/// An 8-bit RGB colour.
+struct Rgb {
+  std::uint8_t r{};
+  std::uint8_t g{};
+  std::uint8_t b{};
+};
+
+/// Colour of the `index`-th curve; the palette repeats after eight.
+inline Rgb curveColor(std::size_t index) {
+  static constexpr Rgb palette[] = {
+      {31, 119, 180},  {214, 39, 40},  {44, 160, 44},   {255, 127, 14},
+      {148, 103, 189}, {140, 86, 75},  {227, 119, 194}, {23, 190, 207}};
+  return palette[index % std::size(palette)];
+}
+
+/**
+ * @brief One entry of a plot, compiled.
+ */
+struct Curve {
+  enum class Kind { Function, Implicit, Parametric, Polar };
+
+  Kind kind{};
+  /// f(x), f(x, y), x(t) and y(t), or r(t), by kind.
+  std::vector<Tokenizer::CompiledExpression> expressions{};
+};
+
+/**
+ * @brief The entries of a plot and the parameters they share.
+ */
+struct CurveList {
+  std::vector<Curve> curves{};           ///< One per entry, in order
+  std::vector<std::string> parameters{}; ///< In order of first use
+};
+
+namespace detail {
+
+// Matches `r = body`, with any spacing.
+inline bool isPolar(const std::string &expression, std::string &body) {
+  const auto r = expression.find_first_not_of(' ');
+  if (r == std::string::npos || expression[r] != 'r')
+    return false;
+  const auto equals = expression.find_first_not_of(' ', r + 1);
+  if (equals == std::string::npos || expression[equals] != '=')
+    return false;
+  body = expression.substr(equals + 1);
+  return true;
+}
+
+// Adds the variables of `expression` other than those in `bound`.
+inline void addParameters(const Tokenizer::CompiledExpression &expression,
+                          std::initializer_list<std::string_view> bound,
+                          std::vector<std::string> &parameters) {
+  for (const auto &name : expression.variables())
+    if (std::find(bound.begin(), bound.end(), name) == bound.end() &&
+        std::find(parameters.begin(), parameters.end(), name) ==
+            parameters.end())
+      parameters.push_back(name);
+}
+
+} // namespace detail
+
+/**
+ * @brief Compiles the entries of a plot, each into the kind of curve its
+ * form asks for:
+ *  - `x(t), y(t)`: a parametric curve,
+ *  - `r = r(t)`: a polar curve, with t the angle,
+ *  - any other expression that uses `y`: the implicit curve f(x, y) = 0,
+ *  - anything else: y = f(x).
+ *
+ * Every variable a curve is not drawn over is a parameter.
+ *
+ * @throws std::runtime_error if an entry is malformed.
+ */
+inline CurveList compileCurves(const std::vector<std::string> &entries) {
+  CurveList list{};
+  for (const std::string &entry : entries) {
+    Curve curve{};
+    std::string polar{};
+    if (auto comma = entry.find(','); comma != std::string::npos) {
+      curve.kind = Curve::Kind::Parametric;
+      curve.expressions.emplace_back(entry.substr(0, comma), "t");
+      curve.expressions.emplace_back(entry.substr(comma + 1), "t");
+      detail::addParameters(curve.expressions[0], {"t"}, list.parameters);
+      detail::addParameters(curve.expressions[1], {"t"}, list.parameters);
+    } else if (detail::isPolar(entry, polar)) {
+      curve.kind = Curve::Kind::Polar;
+      curve.expressions.emplace_back(polar, "t");
+      detail::addParameters(curve.expressions[0], {"t"}, list.parameters);
+    } else {
+      curve.expressions.emplace_back(entry);
+      const bool implicit = curve.expressions[0].slotOf("y") !=
+                            Tokenizer::CompiledExpression::npos;
+      curve.kind = implicit ? Curve::Kind::Implicit : Curve::Kind::Function;
+      if (implicit)
+        detail::addParameters(curve.expressions[0], {"x", "y"},
+                              list.parameters);
+      else
+        detail::addParameters(curve.expressions[0], {"x"}, list.parameters);
+    }
+    list.curves.push_back(std::move(curve));
+  }
+  return list;
+}
+
+} // namespace Sampling
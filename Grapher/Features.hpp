@@ -0,0 +1,229 @@
+#pragma once
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+#include "Sampling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace Sampling {
+
+/**
+ * @brief A point of interest on the curves y = f(x).
+ */
+struct Feature {
+  enum class Kind { Zero, Minimum, Maximum, Intersection };
+
+  Kind kind{};
+  Point at{};
+  std::size_t curve{}; ///< Index of the expression
+  std::size_t other{}; ///< The second expression of an intersection
+};
+
+namespace detail {
+
+/// Grid spacing of the search; features closer than this may merge.
+inline constexpr double kFeatureSpacingPx = 2;
+/// Refinement steps per bracket.
+inline constexpr int kRefineIterations = 64;
+
+/**
+ * Finds the zero of `fn` in [lo, hi], given the value `glo` at `lo` and
+ * `ghi` at `hi` of opposite signs. `fn(x)` returns g(x) with g'(x) as its
+ * derivative, which may be NaN if it is not known.
+ *
+ * Takes the Newton step where the derivative is known and it stays inside
+ * the bracket, otherwise the secant step across the bracket, and bisects
+ * whenever the last step failed to halve the bracket. Returns NaN if g is
+ * undefined somewhere on the way.
+ */
+template <class Fn>
+double refineRoot(const Fn &fn, double lo, double hi, double glo, double ghi) {
+  auto converged = [](double a, double b) {
+    return std::abs(b - a) <= 4 * std::numeric_limits<double>::epsilon() *
+                                  std::max(1.0, std::abs(a));
+  };
+  double x = lo - glo * (hi - lo) / (ghi - glo);
+  double width = hi - lo;
+  for (int i = 0; i < kRefineIterations; ++i) {
+    const Tokenizer::Dual g = fn(x);
+    if (g.value == 0)
+      return x;
+    if (!std::isfinite(g.value))
+      return std::numeric_limits<double>::quiet_NaN();
+    if ((g.value > 0) == (glo > 0)) {
+      lo = x;
+      glo = g.value;
+    } else {
+      hi = x;
+      ghi = g.value;
+    }
+    if (converged(lo, hi))
+      return x;
+
+    double next = x - g.value / g.derivative;
+    if (!(next > lo && next < hi))
+      next = lo - glo * (hi - lo) / (ghi - glo);
+    if (!(next > lo && next < hi) || hi - lo > 0.5 * width)
+      next = 0.5 * (lo + hi);
+    width = hi - lo;
+    if (converged(x, next))
+      return next;
+    x = next;
+  }
+  return x;
+}
+
+} // namespace detail
+
+/**
+ * @brief Finds the zeros, local minima and maxima of every expression and
+ * the intersections of every pair across the viewport's x-range.
+ *
+ * Each expression is evaluated with its slope on a grid of
+ * `kFeatureSpacingPx` wide intervals. Every interval where f, f' or the
+ * difference of two expressions changes sign brackets a feature, and the
+ * brackets are refined in parallel by `detail::refineRoot()` to full double
+ * precision: zeros and intersections with Newton steps, extrema, for which
+ * there is no second derivative, with secant steps. A sign change across a
+ * pole is not a feature. Zeros that only touch the axis show up as extrema.
+ *
+ * @param stop Once requested, no further brackets are refined and `out` is
+ * incomplete.
+ * @return The number of evaluations.
+ */
+inline std::size_t
+findFeatures(std::span<const Tokenizer::CompiledExpression> exprs,
+             const Viewport &view, std::vector<Feature> &out,
+             Tokenizer::ThreadPool *pool = nullptr,
+             const std::stop_token &stop = {}) {
+  const double widthPx = (view.xMax - view.xMin) * view.pixelsPerUnitX;
+  const auto intervals = static_cast<std::size_t>(std::clamp(
+      std::ceil(widthPx / detail::kFeatureSpacingPx), 1.0, 65536.0));
+  const std::size_t points = intervals + 1;
+  const double step =
+      (view.xMax - view.xMin) / static_cast<double>(intervals);
+
+  std::vector<double> xs(points);
+  for (std::size_t i = 0; i < points; ++i)
+    xs[i] = view.xMin + static_cast<double>(i) * step;
+  std::vector<double> values(exprs.size() * points);
+  std::vector<double> slopes(exprs.size() * points);
+  auto evaluate = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t e = begin; e < end; ++e)
+      exprs[e].evalDualBatch(xs, {values.data() + e * points, points},
+                             {slopes.data() + e * points, points});
+  };
+  if (pool)
+    pool->parallelFor(exprs.size(), 1, evaluate);
+  else
+    evaluate(0, exprs.size());
+  std::size_t evaluations = exprs.size() * points;
+
+  struct Bracket {
+    Feature::Kind kind{};
+    std::size_t curve{};
+    std::size_t other{};
+    std::size_t i{}; ///< The interval [xs[i], xs[i + 1]]
+  };
+  std::vector<Bracket> brackets{};
+  auto changes = [](double a, double b) {
+    return std::isfinite(a) && std::isfinite(b) && (a > 0) != (b > 0);
+  };
+  for (std::size_t e = 0; e < exprs.size(); ++e) {
+    const double *f = values.data() + e * points;
+    const double *df = slopes.data() + e * points;
+    for (std::size_t i = 0; i + 1 < points; ++i) {
+      if (changes(f[i], f[i + 1]))
+        brackets.push_back({Feature::Kind::Zero, e, e, i});
+      if (changes(df[i], df[i + 1]))
+        brackets.push_back({df[i] > 0 ? Feature::Kind::Maximum
+                                      : Feature::Kind::Minimum,
+                            e, e, i});
+    }
+    for (std::size_t o = e + 1; o < exprs.size(); ++o) {
+      const double *g = values.data() + o * points;
+      for (std::size_t i = 0; i + 1 < points; ++i)
+        if (changes(f[i] - g[i], f[i + 1] - g[i + 1]))
+          brackets.push_back({Feature::Kind::Intersection, e, o, i});
+    }
+  }
+
+  std::vector<Feature> found(brackets.size());
+  std::vector<char> valid(brackets.size(), 0);
+  std::atomic<std::size_t> spent{0};
+  auto refine = [&](std::size_t begin, std::size_t end) {
+    std::size_t count = 0;
+    for (std::size_t b = begin; b < end && !stop.stop_requested(); ++b) {
+      const Bracket &bracket = brackets[b];
+      const auto &f = exprs[bracket.curve];
+      const auto &g = exprs[bracket.other];
+      const double lo = xs[bracket.i];
+      const double hi = xs[bracket.i + 1];
+      if (detail::hasPole(f, lo, hi) ||
+          (bracket.other != bracket.curve && detail::hasPole(g, lo, hi)))
+        continue;
+
+      const double *fv = values.data() + bracket.curve * points;
+      const double *fd = slopes.data() + bracket.curve * points;
+      const double *gv = values.data() + bracket.other * points;
+      double x{};
+      switch (bracket.kind) {
+      case Feature::Kind::Zero:
+        x = detail::refineRoot(
+            [&](double t) {
+              ++count;
+              return f.evalDual(t);
+            },
+            lo, hi, fv[bracket.i], fv[bracket.i + 1]);
+        break;
+      case Feature::Kind::Minimum:
+      case Feature::Kind::Maximum:
+        x = detail::refineRoot(
+            [&](double t) {
+              ++count;
+              return Tokenizer::Dual{f.evalDual(t).derivative,
+                                     std::numeric_limits<double>::quiet_NaN()};
+            },
+            lo, hi, fd[bracket.i], fd[bracket.i + 1]);
+        break;
+      case Feature::Kind::Intersection:
+        x = detail::refineRoot(
+            [&](double t) {
+              count += 2;
+              const auto a = f.evalDual(t);
+              const auto c = g.evalDual(t);
+              return Tokenizer::Dual{a.value - c.value,
+                                     a.derivative - c.derivative};
+            },
+            lo, hi, fv[bracket.i] - gv[bracket.i],
+            fv[bracket.i + 1] - gv[bracket.i + 1]);
+        break;
+      }
+      const double y = f.eval(x);
+      ++count;
+      if (!std::isfinite(x) || !std::isfinite(y))
+        continue;
+      found[b] = {bracket.kind, {x, y}, bracket.curve, bracket.other};
+      valid[b] = 1;
+    }
+    spent.fetch_add(count, std::memory_order_relaxed);
+  };
+  if (pool)
+    pool->parallelFor(brackets.size(), 16, refine);
+  else
+    refine(0, brackets.size());
+
+  for (std::size_t b = 0; b < found.size(); ++b)
+    if (valid[b])
+      out.push_back(found[b]);
+  return evaluations + spent;
+}
+
+} // namespace Sampling
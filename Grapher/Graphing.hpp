@@ -1,158 +1,812 @@
 #pragma once
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/Incremental.hpp"
+#include "../functionParser/ThreadPool.hpp"
 #include "../functionParser/Tokenizer.hpp"
+#include "Axes.hpp"
+#include "Curves.hpp"
+#include "Features.hpp"
+#include "Implicit.hpp"
+#include "Parametric.hpp"
+#include "Profiler.hpp"
+#include "Sampling.hpp"
+#include "TileCache.hpp"
 #include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/Glyph.hpp>
 #include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/RenderStates.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/Graphics/Text.hpp>
 #include <SFML/Graphics/VertexArray.hpp>
+#include <SFML/System/Clock.hpp>
 #include <SFML/System/Vector2.hpp>
 #include <SFML/Window/Event.hpp>
+#include <SFML/Window/Keyboard.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <fmt/base.h>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <span>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
-inline static float getNiceStep(float range) {
-  float rough = range / 10.0f;
-  float scale = std::pow(10.0f, std::floor(std::log10(rough)));
-  float normalized = rough / scale;
-
-  if (normalized < 1.5f)
-    return scale;
-  if (normalized < 3.0f)
-    return scale * 2.0f;
-  if (normalized < 7.0f)
-    return scale * 5.0f;
-  return scale * 10.0f;
-}
-
-static inline std::string formatNumber(float value) {
-  if (std::abs(value) < 1e-10)
-    return "0";
-  if (std::abs(value) >= 10000 || std::abs(value) < 0.01) {
-    return fmt::format("{:.1e}", value);
-  }
-  return fmt::format("{:.2g}", value);
-}
-
+/**
+ * @class AxisSystem
+ * @brief The grid, the axes, their ticks and the tick labels.
+ *
+ * All of it depends only on the view and the window size, so `update()`
+ * rebuilds it only when one of them changes and otherwise just compares
+ * them. The grid comes from `layoutAxes()`, one line per step on each
+ * axis.
+ *
+ * Labels come from a glyph atlas baked when the system is made: the label
+ * characters are rendered once into the texture of a private copy of the
+ * font, and every label is a run of textured quads in one vertex array, so
+ * all of them together are a single draw call.
+ */
 class AxisSystem {
-private:
-  sf::VertexArray m_gridLines;
-  sf::VertexArray m_axisTicks;
-  sf::Font &m_font;
-
 public:
-  AxisSystem(sf::Font &font)
-      : m_font(font), m_gridLines(sf::Lines), m_axisTicks(sf::Lines) {}
+  /// Height of the label text, in pixels.
+  static constexpr unsigned kLabelSize = 12;
+  /// Gap between an axis and its labels, in pixels.
+  static constexpr float kLabelGapPx = 4;
+
+  AxisSystem(const sf::Font &font) : m_font(font) {
+    for (std::size_t i = 0; i < kLabelChars.size(); ++i)
+      m_glyphs[i] = m_font.getGlyph(kLabelChars[i], kLabelSize, false);
+  }
 
   void update(const sf::View &view, const sf::Vector2u &windowSize) {
+    if (view.getCenter() == m_center && view.getSize() == m_size &&
+        windowSize == m_windowSize)
+      return;
+    m_center = view.getCenter();
+    m_size = view.getSize();
+    m_windowSize = windowSize;
+
     m_gridLines.clear();
     m_axisTicks.clear();
+    m_labels.clear();
 
-    // Calculate view bounds
-    sf::Vector2f viewCenter = view.getCenter();
-    sf::Vector2f viewSize = view.getSize();
-    float xMin = viewCenter.x - viewSize.x / 2;
-    float xMax = viewCenter.x + viewSize.x / 2;
-    float yMin = viewCenter.y - viewSize.y / 2;
-    float yMax = viewCenter.y + viewSize.y / 2;
-
-    // Calculate steps for grid and labels
-    float xStep = getNiceStep(xMax - xMin);
-    float yStep = getNiceStep(yMax - yMin);
-
-    // Calculate starting positions
-    float xStart = std::floor(xMin / xStep) * xStep;
-    float yStart = std::floor(yMin / yStep) * yStep;
-
-    // Calculate pixel-to-unit ratios
-    float unitsPerPixelY = viewSize.y / windowSize.y;
-    float baseTextSize = 14.0f;                     // Base size in pixels
-    float textSize = baseTextSize / unitsPerPixelY; // Scale text size with zoom
-
-    // Tick size in view units
-    float tickSize = 0.2f * unitsPerPixelY;
-
-    // Create grid lines and labels
-    for (float x = xStart; x <= xMax; x += xStep) {
-      // Vertical grid line
-      m_gridLines.append(
-          sf::Vertex(sf::Vector2f(x, yMin), sf::Color(200, 200, 200, 100)));
-      m_gridLines.append(
-          sf::Vertex(sf::Vector2f(x, yMax), sf::Color(200, 200, 200, 100)));
-
-      // Tick mark on x-axis
-      m_axisTicks.append(
-          sf::Vertex(sf::Vector2f(x, -tickSize), sf::Color::Black));
-      m_axisTicks.append(
-          sf::Vertex(sf::Vector2f(x, tickSize), sf::Color::Black));
-
-      for (float y = yStart; y <= yMax; y += yStep) {
-        // Horizontal grid line
-        m_gridLines.append(
-            sf::Vertex(sf::Vector2f(xMin, y), sf::Color(200, 200, 200, 100)));
-        m_gridLines.append(
-            sf::Vertex(sf::Vector2f(xMax, y), sf::Color(200, 200, 200, 100)));
-
-        // Tick mark on y-axis
-        m_axisTicks.append(
-            sf::Vertex(sf::Vector2f(-tickSize, y), sf::Color::Black));
-        m_axisTicks.append(
-            sf::Vertex(sf::Vector2f(tickSize, y), sf::Color::Black));
-      }
+    const float xMin = m_center.x - m_size.x / 2;
+    const float xMax = m_center.x + m_size.x / 2;
+    const float yMin = m_center.y - m_size.y / 2;
+    const float yMax = m_center.y + m_size.y / 2;
+    const AxisLayout layout = layoutAxes(xMin, xMax, yMin, yMax);
+    const sf::Vector2f unitsPerPixel(m_size.x / windowSize.x,
+                                     m_size.y / windowSize.y);
+    const float tickX = kAxisTickPx * unitsPerPixel.x;
+    const float tickY = kAxisTickPx * unitsPerPixel.y;
+    const sf::Color gridColor(200, 200, 200, 100);
 
-      // Main axes (drawn last to be on top)
-      m_gridLines.append(sf::Vertex(sf::Vector2f(xMin, 0), sf::Color::Black));
-      m_gridLines.append(sf::Vertex(sf::Vector2f(xMax, 0), sf::Color::Black));
-      m_gridLines.append(sf::Vertex(sf::Vector2f(0, yMin), sf::Color::Black));
-      m_gridLines.append(sf::Vertex(sf::Vector2f(0, yMax), sf::Color::Black));
+    auto line = [](sf::VertexArray &lines, sf::Vector2f a, sf::Vector2f b,
+                   sf::Color color) {
+      lines.append(sf::Vertex(a, color));
+      lines.append(sf::Vertex(b, color));
+    };
+    for (const float x : layout.xs) {
+      line(m_gridLines, {x, yMin}, {x, yMax}, gridColor);
+      line(m_axisTicks, {x, -tickY}, {x, tickY}, sf::Color::Black);
+    }
+    for (const float y : layout.ys) {
+      line(m_gridLines, {xMin, y}, {xMax, y}, gridColor);
+      line(m_axisTicks, {-tickX, y}, {tickX, y}, sf::Color::Black);
+    }
+    // Main axes, on top of the grid
+    line(m_gridLines, {xMin, 0}, {xMax, 0}, sf::Color::Black);
+    line(m_gridLines, {0, yMin}, {0, yMax}, sf::Color::Black);
+
+    // Labels follow their axis, but stay on screen when it scrolls off.
+    const float ascent = -glyph('0')->bounds.top;
+    const float labelHeight = ascent + kLabelGapPx;
+    const float xAxis = std::min(
+        std::max(0.f, yMin),
+        yMax - (labelHeight + kLabelGapPx) * unitsPerPixel.y);
+    for (const float x : layout.xs) {
+      const std::string text = formatNumber(x);
+      const float width = textWidth(text);
+      label(text, {x, xAxis},
+            {-width / 2, kLabelGapPx + ascent}, unitsPerPixel);
+    }
+    for (const float y : layout.ys) {
+      // The x-axis labels already have a 0.
+      if (std::abs(y) < layout.yStep / 2)
+        continue;
+      // View y grows downwards, so the label shows -y.
+      const std::string text = formatNumber(-y);
+      const float width = textWidth(text);
+      const float yAxis = std::min(
+          std::max(0.f, xMin + (width + 2 * kLabelGapPx) * unitsPerPixel.x),
+          xMax);
+      label(text, {yAxis, y}, {-width - kLabelGapPx, ascent / 2},
+            unitsPerPixel);
     }
   }
+
   void draw(sf::RenderTarget &target,
-            sf::RenderStates states = sf::RenderStates::Default) {
+            sf::RenderStates states = sf::RenderStates::Default) const {
     // Draw grid and axes
     target.draw(m_gridLines, states);
     target.draw(m_axisTicks, states);
+    states.texture = &m_font.getTexture(kLabelSize);
+    target.draw(m_labels, states);
+  }
+
+private:
+  /// Every character `formatNumber()` writes.
+  static constexpr std::string_view kLabelChars = "0123456789.-+e";
+
+  const sf::Glyph *glyph(char c) const {
+    const auto i = kLabelChars.find(c);
+    return i == std::string_view::npos ? nullptr : &m_glyphs[i];
+  }
+
+  float textWidth(const std::string &text) const {
+    float width = 0;
+    for (const char c : text)
+      if (const sf::Glyph *g = glyph(c))
+        width += g->advance;
+    return width;
+  }
+
+  // Adds `text` with its baseline starting `offsetPx` pixels from `anchor`.
+  void label(const std::string &text, sf::Vector2f anchor,
+             sf::Vector2f offsetPx, sf::Vector2f unitsPerPixel) {
+    auto at = [&](float px, float py) {
+      return sf::Vector2f(anchor.x + px * unitsPerPixel.x,
+                          anchor.y + py * unitsPerPixel.y);
+    };
+    float pen = offsetPx.x;
+    for (const char c : text) {
+      const sf::Glyph *g = glyph(c);
+      if (!g)
+        continue;
+      const float left = pen + g->bounds.left;
+      const float top = offsetPx.y + g->bounds.top;
+      const float right = left + g->bounds.width;
+      const float bottom = top + g->bounds.height;
+      const sf::IntRect &rect = g->textureRect;
+      const auto u0 = static_cast<float>(rect.left);
+      const auto v0 = static_cast<float>(rect.top);
+      const auto u1 = static_cast<float>(rect.left + rect.width);
+      const auto v1 = static_cast<float>(rect.top + rect.height);
+      const sf::Vertex corners[] = {
+          sf::Vertex(at(left, top), sf::Color::Black, {u0, v0}),
+          sf::Vertex(at(right, top), sf::Color::Black, {u1, v0}),
+          sf::Vertex(at(right, bottom), sf::Color::Black, {u1, v1}),
+          sf::Vertex(at(left, bottom), sf::Color::Black, {u0, v1})};
+      for (const int i : {0, 1, 2, 0, 2, 3})
+        m_labels.append(corners[i]);
+      pen += g->advance;
+    }
   }
+
+  sf::Font m_font; ///< Own copy, so its atlas only holds label glyphs
+  std::array<sf::Glyph, kLabelChars.size()> m_glyphs{};
+  sf::VertexArray m_gridLines{sf::Lines};
+  sf::VertexArray m_axisTicks{sf::Lines};
+  sf::VertexArray m_labels{sf::Triangles};
+
+  // What the geometry was built for.
+  sf::Vector2f m_center{};
+  sf::Vector2f m_size{};
+  sf::Vector2u m_windowSize{};
 };
 
-class Graph {
+/**
+ * @class GraphSet
+ * @brief Plots several expressions together, sampling them on a background
+ * thread.
+ *
+ * Every curve is sampled on the same x-grid: each block of x-values is run
+ * through all the expressions in turn while it is still in cache, and a tile
+ * holds the samples of every curve. All curves go into one vertex array,
+ * told apart by vertex colour, so the whole set is a single draw call.
+ *
+ * Besides y = f(x), an entry can be a parametric, polar or implicit
+ * curve; see `Sampling::compileCurves()`. These depend on the whole view rather than on x alone, so they are
+ * sampled afresh for every view instead of being cached by tile.
+ *
+ * On request the worker also finds the zeros, extrema and intersections of
+ * the y = f(x) curves across the view with `Sampling::findFeatures()` and
+ * marks them. They only depend on the view's x-range and resolution, so the
+ * last few results are kept and panning back reuses them.
+ *
+ * Every variable a curve is not drawn over is a parameter, set with
+ * `setParameters()`. New parameter values invalidate the tiles. In uniform
+ * mode the y = f(x) curves are then swept across the view at one sample per
+ * pixel column by a `Tokenizer::IncrementalEvaluator` each. Each evaluator
+ * keeps the per-sample values of every subexpression that does not depend
+ * on a parameter that changed, so moving a slider over a still view only
+ * redoes the part of each curve that depends on it.
+ *
+ * `update()` only records what the view needs. A worker thread samples it
+ * and builds the geometry into a back buffer while `draw()` keeps showing
+ * the last finished one, so input never waits on the expressions. The two
+ * buffers are handed over through a third, middle one with a single atomic
+ * exchange on either side, so neither thread ever blocks on the other. A
+ * job that is still running when the view changes again is cancelled; the
+ * tiles it did finish stay cached for the next one.
+ */
+class GraphSet {
+public:
+  enum class SamplingMode { Uniform, Adaptive };
+
+  /// Uniform samples per cached tile.
+  static constexpr std::size_t kSamplesPerTile = 256;
+
+  /// What the last finished job did.
+  struct Stats {
+    std::size_t samples{};   ///< Evaluations spent
+    std::size_t tiles{};     ///< Tiles in the cache afterwards
+    std::size_t tileBytes{}; ///< Bytes they use
+    std::size_t features{};  ///< Features found
+    std::size_t nodes{};      ///< Nodes of the swept curves, if swept
+    std::size_t recomputed{}; ///< How many of those the sweep recomputed
+  };
+
+  /// Results of `Sampling::findFeatures()` kept for recent views.
+  static constexpr std::size_t kFeatureCacheEntries = 16;
+  /// Half the width of a feature marker.
+  static constexpr double kMarkerPx = 4;
+
 private:
-  sf::VertexArray m_vertices;
-  std::string m_expression;
+  struct Request {
+    Sampling::Viewport viewport{};
+    SamplingMode mode{};
+    Sampling::AdaptiveSettings adaptive{};
+    bool features{};
+    std::vector<double> parameters{};
+
+    bool operator==(const Request &other) const = default;
+  };
+
+  struct FeatureEntry {
+    double xMin{};
+    double xMax{};
+    double pixelsPerUnitX{};
+    std::vector<Sampling::Feature> features{};
+  };
+
+  // Buffer index in the low bits; set when the middle buffer holds a job's
+  // result that draw() has not picked up yet.
+  static constexpr unsigned kFresh = 4;
+
+  std::vector<Tokenizer::CompiledExpression> m_expressions{};
+  std::vector<sf::Color> m_colors{};
+  std::vector<std::size_t> m_inputs{}; ///< Input index of every expression
+  /// A curve sampled for the whole view rather than by x-tile.
+  struct ViewCurve {
+    Sampling::Curve::Kind kind{};
+    std::vector<Tokenizer::CompiledExpression> expressions{};
+    sf::Color color{};
+  };
+  std::vector<ViewCurve> m_viewCurves{};
+  std::vector<std::string> m_parameters{}; ///< In order of first use
+  SamplingMode m_mode{SamplingMode::Uniform};
+  Sampling::AdaptiveSettings m_adaptive{};
+  bool m_showFeatures{};
+
+  // Owned by the render thread.
+  std::optional<Request> m_lastRequest{};
+  std::vector<double> m_parameterValues{};
+  unsigned m_front{0};
+
+  // Owned by the worker.
+  Sampling::TileCache m_tiles{};
+  std::vector<const Sampling::Tile *> m_visible{};
+  std::vector<std::size_t> m_offsets{}; ///< First vertex of every curve
+  std::vector<std::vector<Sampling::Segment>> m_segments{}; ///< Per ViewCurve
+  std::vector<Sampling::Point> m_path{};
+  std::vector<FeatureEntry> m_featureCache{}; ///< Most recent last
+  std::vector<double> m_applied{}; ///< Parameter values the curves hold
+  std::vector<Tokenizer::IncrementalEvaluator> m_sweeps{};
+  std::vector<double> m_sweepGrid{};
+  Sampling::Tile m_sweepTile{};
+  unsigned m_back{1};
+
+  sf::VertexArray m_buffers[3];
+  Stats m_stats[3]{};
+  std::vector<Sampling::Feature> m_features[3]{};
+  std::atomic<unsigned> m_middle{2};
+  std::atomic<bool> m_busy{};
+
+  std::mutex m_mutex{};
+  std::condition_variable m_wake{};
+  std::optional<Request> m_pending{}; ///< Guarded by m_mutex
+  std::stop_source m_job{};           ///< Guarded by m_mutex
+  bool m_quit{};                      ///< Guarded by m_mutex
+  std::thread m_worker{};
+
+  static bool isDrawable(const Sampling::Point &a, const Sampling::Point &b) {
+    return std::isfinite(static_cast<float>(a.y)) &&
+           std::isfinite(static_cast<float>(b.y));
+  }
+
+  void workerLoop() {
+    FNP_PROFILE_THREAD("sampler");
+    std::optional<SamplingMode> cachedMode{};
+    for (;;) {
+      Request request{};
+      std::stop_token stop{};
+      {
+        std::unique_lock lock(m_mutex);
+        m_wake.wait(lock, [&] { return m_quit || m_pending.has_value(); });
+        if (m_quit)
+          return;
+        request = *m_pending;
+        m_pending.reset();
+        stop = m_job.get_token();
+        m_busy = true;
+      }
+
+      // Tiles are sampled for one mode only.
+      if (cachedMode != request.mode)
+        m_tiles.clear();
+      cachedMode = request.mode;
+
+      // Tiles and features are only right for the values they were found
+      // with.
+      const bool parametersChanged = request.parameters != m_applied;
+      if (parametersChanged) {
+        applyParameters(request.parameters);
+        m_tiles.clear();
+        m_featureCache.clear();
+      }
+
+      bool built = false;
+      {
+        FNP_PROFILE_SCOPE(Sample);
+        built = build(request, parametersChanged, stop);
+      }
+      FNP_PROFILE_COUNT(Evaluations, m_stats[m_back].samples);
+      if (built) {
+        m_back = m_middle.exchange(m_back | kFresh) & ~kFresh;
+      }
+      m_busy = false;
+    }
+  }
+
+  void applyParameters(const std::vector<double> &values) {
+    m_applied = values;
+    auto apply = [&](Tokenizer::CompiledExpression &expression) {
+      for (std::size_t i = 0; i < std::min(values.size(), m_parameters.size());
+           ++i)
+        expression.setVariable(m_parameters[i], values[i]);
+    };
+    for (auto &expression : m_expressions)
+      apply(expression);
+    for (auto &curve : m_viewCurves)
+      for (auto &expression : curve.expressions)
+        apply(expression);
+  }
+
+  /**
+   * Samples the y = f(x) curves at every pixel column of the view through
+   * their incremental evaluators. The grid is kept while the view stays
+   * the same, so only what the new parameter values change is recomputed.
+   */
+  std::size_t sweep(const Sampling::Viewport &view, Stats &stats,
+                    Tokenizer::ThreadPool &pool) {
+    const std::size_t curves = m_expressions.size();
+    const auto count = static_cast<std::size_t>(std::clamp(
+        std::ceil((view.xMax - view.xMin) * view.pixelsPerUnitX), 1.0, 1e5));
+    const std::size_t points = count + 1;
+    const double step = (view.xMax - view.xMin) / static_cast<double>(count);
+
+    if (m_sweeps.empty())
+      for (const auto &expression : m_expressions)
+        m_sweeps.emplace_back(expression);
+    if (m_sweepGrid.size() != points || m_sweepGrid.front() != view.xMin ||
+        m_sweepGrid[1] != view.xMin + step) {
+      m_sweepGrid.resize(points);
+      for (std::size_t i = 0; i < points; ++i)
+        m_sweepGrid[i] = view.xMin + static_cast<double>(i) * step;
+      for (auto &evaluator : m_sweeps)
+        evaluator.setGrid(m_sweepGrid);
+    }
+
+    Sampling::Tile &tile = m_sweepTile;
+    tile.points.resize(curves * points);
+    tile.ends.clear();
+    for (std::size_t c = 1; c <= curves; ++c)
+      tile.ends.push_back(c * points);
+    std::atomic<std::size_t> evaluations{0};
+    std::atomic<std::size_t> recomputed{0};
+    pool.parallelFor(curves, 1, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t c = begin; c < end; ++c) {
+        const auto ys = m_sweeps[c].evaluate(m_expressions[c].values());
+        Sampling::Point *curve = tile.points.data() + c * points;
+        for (std::size_t i = 0; i < points; ++i)
+          curve[i] = {m_sweepGrid[i], ys[i]};
+        // Broken at poles like a uniformly sampled tile.
+        for (std::size_t i = 0; i + 1 < points; ++i) {
+          Sampling::Point &a = curve[i];
+          Sampling::Point &b = curve[i + 1];
+          if (Sampling::detail::isSteep(a, b, view) &&
+              Sampling::detail::hasPole(m_expressions[c], a.x, b.x))
+            (std::abs(a.y) > std::abs(b.y) ? a : b).y =
+                std::numeric_limits<double>::quiet_NaN();
+        }
+        evaluations += m_sweeps[c].evaluations();
+        recomputed += m_sweeps[c].recomputed();
+      }
+    });
+
+    stats.nodes = 0;
+    for (const auto &evaluator : m_sweeps)
+      stats.nodes += evaluator.nodeCount();
+    stats.recomputed = recomputed;
+    m_visible.assign(1, &tile);
+    return evaluations;
+  }
+
+  /// Fills the back buffer; false if the job was cancelled part way.
+  bool build(const Request &request, bool parametersChanged,
+             const std::stop_token &stop) {
+    const std::size_t curves = m_expressions.size();
+    auto sample = [&](const Sampling::Viewport &view, Sampling::Tile &tile) {
+      std::size_t evaluations = 0;
+      if (request.mode == SamplingMode::Adaptive) {
+        // Every curve refines where it bends, so there is no grid to share.
+        for (const auto &expression : m_expressions) {
+          evaluations += Sampling::sampleAdaptive(expression, view,
+                                                  request.adaptive,
+                                                  tile.points);
+          tile.endCurve();
+        }
+        return evaluations;
+      }
+      evaluations = Sampling::sampleUniform(m_expressions, view,
+                                            kSamplesPerTile, tile.points);
+      for (std::size_t c = 1; c <= curves; ++c)
+        tile.ends.push_back(c * tile.points.size() / curves);
+      return evaluations;
+    };
+    auto &pool = Tokenizer::ThreadPool::shared();
+    Stats &stats = m_stats[m_back];
+    stats.samples = 0;
+    stats.nodes = 0;
+    stats.recomputed = 0;
+    m_visible.clear();
+    if (curves > 0 && parametersChanged &&
+        request.mode == SamplingMode::Uniform)
+      stats.samples = sweep(request.viewport, stats, pool);
+    else if (curves > 0)
+      stats.samples =
+          m_tiles.collect(request.viewport, sample, m_visible, &pool, stop);
+    stats.tiles = m_tiles.size();
+    stats.tileBytes = m_tiles.bytes();
+
+    m_segments.resize(m_viewCurves.size());
+    for (std::size_t c = 0; c < m_viewCurves.size(); ++c) {
+      const ViewCurve &curve = m_viewCurves[c];
+      auto &segments = m_segments[c];
+      segments.clear();
+      if (curve.kind == Sampling::Curve::Kind::Implicit) {
+        stats.samples += Sampling::contourImplicit(
+            curve.expressions[0], request.viewport, {}, segments, &pool, stop);
+        continue;
+      }
+      m_path.clear();
+      if (curve.kind == Sampling::Curve::Kind::Parametric)
+        stats.samples += Sampling::sampleParametric(
+            curve.expressions[0], curve.expressions[1], request.viewport, {},
+            m_path);
+      else
+        stats.samples += Sampling::samplePolar(
+            curve.expressions[0], request.viewport, {}, m_path);
+      for (std::size_t i = 0; i + 1 < m_path.size(); ++i)
+        if (isDrawable(m_path[i], m_path[i + 1]))
+          segments.push_back({m_path[i], m_path[i + 1]});
+    }
+    std::vector<Sampling::Feature> &features = m_features[m_back];
+    features.clear();
+    if (request.features)
+      stats.samples += findFeatures(request.viewport, features, pool, stop);
+    stats.features = features.size();
+    if (stop.stop_requested())
+      return false;
+
+    // Every curve of every tile gets its own stretch of the vertex array,
+    // sized by a count of its finite segments, so the tiles are converted in
+    // parallel without any locking.
+    m_offsets.assign(m_visible.size() * curves + 1, 0);
+    pool.parallelFor(m_visible.size(), 1, [&](std::size_t begin,
+                                              std::size_t end) {
+      for (std::size_t t = begin; t < end; ++t) {
+        for (std::size_t c = 0; c < curves; ++c) {
+          const auto points = m_visible[t]->curve(c);
+          std::size_t segments = 0;
+          for (std::size_t i = 0; i + 1 < points.size(); ++i)
+            segments += isDrawable(points[i], points[i + 1]);
+          m_offsets[t * curves + c + 1] = 2 * segments;
+        }
+      }
+    });
+    for (std::size_t i = 0; i + 1 < m_offsets.size(); ++i)
+      m_offsets[i + 1] += m_offsets[i];
+
+    std::size_t viewCurveVertices = 0;
+    for (const auto &segments : m_segments)
+      viewCurveVertices += 2 * segments.size();
+
+    sf::VertexArray &vertices = m_buffers[m_back];
+    vertices.resize(m_offsets.back() + viewCurveVertices +
+                    4 * features.size());
+    pool.parallelFor(m_visible.size(), 1, [&](std::size_t begin,
+                                              std::size_t end) {
+      for (std::size_t t = begin; t < end; ++t) {
+        for (std::size_t c = 0; c < curves; ++c) {
+          const auto points = m_visible[t]->curve(c);
+          const sf::Color color = m_colors[c];
+          std::size_t v = m_offsets[t * curves + c];
+          for (std::size_t i = 0; i + 1 < points.size(); ++i) {
+            if (!isDrawable(points[i], points[i + 1]))
+              continue;
+            vertices[v++] = sf::Vertex(
+                sf::Vector2f(static_cast<float>(points[i].x),
+                             -static_cast<float>(points[i].y)),
+                color);
+            vertices[v++] = sf::Vertex(
+                sf::Vector2f(static_cast<float>(points[i + 1].x),
+                             -static_cast<float>(points[i + 1].y)),
+                color);
+          }
+        }
+      }
+    });
+
+    std::size_t v = m_offsets.back();
+    for (std::size_t c = 0; c < m_segments.size(); ++c) {
+      for (const auto &segment : m_segments[c]) {
+        vertices[v++] = sf::Vertex(
+            sf::Vector2f(static_cast<float>(segment.a.x),
+                         -static_cast<float>(segment.a.y)),
+            m_viewCurves[c].color);
+        vertices[v++] = sf::Vertex(
+            sf::Vector2f(static_cast<float>(segment.b.x),
+                         -static_cast<float>(segment.b.y)),
+            m_viewCurves[c].color);
+      }
+    }
+
+    // Every feature is marked with a cross of the colour of its curve.
+    const auto dx =
+        static_cast<float>(kMarkerPx / request.viewport.pixelsPerUnitX);
+    const auto dy =
+        static_cast<float>(kMarkerPx / request.viewport.pixelsPerUnitY);
+    for (const auto &feature : features) {
+      const sf::Vector2f at(static_cast<float>(feature.at.x),
+                            -static_cast<float>(feature.at.y));
+      const sf::Color color = m_colors[feature.curve];
+      vertices[v++] = sf::Vertex(at + sf::Vector2f(-dx, -dy), color);
+      vertices[v++] = sf::Vertex(at + sf::Vector2f(dx, dy), color);
+      vertices[v++] = sf::Vertex(at + sf::Vector2f(-dx, dy), color);
+      vertices[v++] = sf::Vertex(at + sf::Vector2f(dx, -dy), color);
+    }
+    return true;
+  }
+
+  /// Finds the features across the view, or takes them from the cache.
+  std::size_t findFeatures(const Sampling::Viewport &view,
+                           std::vector<Sampling::Feature> &out,
+                           Tokenizer::ThreadPool &pool,
+                           const std::stop_token &stop) {
+    auto hit = std::find_if(
+        m_featureCache.begin(), m_featureCache.end(), [&](const auto &entry) {
+          return entry.xMin == view.xMin && entry.xMax == view.xMax &&
+                 entry.pixelsPerUnitX == view.pixelsPerUnitX;
+        });
+    if (hit != m_featureCache.end()) {
+      std::rotate(hit, hit + 1, m_featureCache.end());
+      out = m_featureCache.back().features;
+      return 0;
+    }
+
+    const std::size_t evaluations =
+        Sampling::findFeatures(m_expressions, view, out, &pool, stop);
+    if (stop.stop_requested())
+      return evaluations;
+    if (m_featureCache.size() == kFeatureCacheEntries)
+      m_featureCache.erase(m_featureCache.begin());
+    m_featureCache.push_back({view.xMin, view.xMax, view.pixelsPerUnitX, out});
+    return evaluations;
+  }
 
 public:
-  Graph(const std::string &expression) : m_expression(expression) {
-    m_vertices.setPrimitiveType(sf::Lines);
+  /// Colour of the `index`-th curve; the palette repeats after eight.
+  static sf::Color curveColor(std::size_t index) {
+    const Sampling::Rgb color = Sampling::curveColor(index);
+    return sf::Color(color.r, color.g, color.b);
   }
 
-  void calculatePoints(const sf::View &view) {
-    m_vertices.clear();
-    sf::Vector2f viewSize = view.getSize();
-    sf::Vector2f viewCenter = view.getCenter();
+  /**
+   * @brief Compiles the expressions and starts the worker.
+   * @throws std::runtime_error if an expression is malformed.
+   */
+  GraphSet(const std::vector<std::string> &expressions) {
+    Sampling::CurveList list = Sampling::compileCurves(expressions);
+    for (std::size_t i = 0; i < list.curves.size(); ++i) {
+      Sampling::Curve &curve = list.curves[i];
+      if (curve.kind == Sampling::Curve::Kind::Function) {
+        m_expressions.push_back(std::move(curve.expressions[0]));
+        m_colors.push_back(curveColor(i));
+        m_inputs.push_back(i);
+        continue;
+      }
+      m_viewCurves.push_back(
+          {curve.kind, std::move(curve.expressions), curveColor(i)});
+    }
+    m_parameters = std::move(list.parameters);
+    m_parameterValues.assign(m_parameters.size(), 1.0);
+    for (auto &buffer : m_buffers)
+      buffer.setPrimitiveType(sf::Lines);
+    m_worker = std::thread([this] { workerLoop(); });
+  }
+
+  ~GraphSet() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_quit = true;
+      m_job.request_stop();
+    }
+    m_wake.notify_one();
+    m_worker.join();
+  }
+
+  GraphSet(const GraphSet &) = delete;
+  GraphSet &operator=(const GraphSet &) = delete;
+
+  std::size_t size() const {
+    return m_expressions.size() + m_viewCurves.size();
+  }
+
+  void setSamplingMode(SamplingMode mode) { m_mode = mode; }
+  SamplingMode samplingMode() const { return m_mode; }
+  void setAdaptiveSettings(const Sampling::AdaptiveSettings &settings) {
+    m_adaptive = settings;
+  }
+  const Sampling::AdaptiveSettings &adaptiveSettings() const {
+    return m_adaptive;
+  }
+  /// Whether zeros, extrema and intersections are found and marked.
+  void setShowFeatures(bool show) { m_showFeatures = show; }
+  bool showFeatures() const { return m_showFeatures; }
 
-    float xStart = viewCenter.x - viewSize.x / 2;
-    float xEnd = viewCenter.x + viewSize.x / 2;
-    float step = viewSize.x / 800; // Adjust for desired resolution
+  /// Names of the parameters, in the order `setParameters()` takes them.
+  const std::vector<std::string> &parameters() const { return m_parameters; }
 
-    for (float x = xStart; x < xEnd; x += step) {
-      float y1 = Tokenizer::evaluate<float>(m_expression, {{'x', x}});
-      float y2 = Tokenizer::evaluate<float>(m_expression, {{'x', x + step}});
+  /**
+   * @brief Sets the value of every parameter for the next `update()`.
+   *
+   * Parameters start out at 1.
+   */
+  void setParameters(std::span<const double> values) {
+    m_parameterValues.assign(values.begin(), values.end());
+  }
 
-      if (std::isfinite(y1) && std::isfinite(y2)) {
-        m_vertices.append(sf::Vertex(sf::Vector2f(x, -y1), sf::Color::Blue));
-        m_vertices.append(
-            sf::Vertex(sf::Vector2f(x + step, -y2), sf::Color::Blue));
+  /// The features marked in the geometry draw() currently shows.
+  const std::vector<Sampling::Feature> &features() const {
+    return m_features[m_front];
+  }
+
+  /**
+   * @brief Finds the marked feature closest to a point of the graph.
+   * @param radiusPx How far from the point, in pixels, to look.
+   * @return The feature, or nullptr if none is that close.
+   */
+  const Sampling::Feature *featureNear(double x, double y,
+                                       double radiusPx) const {
+    if (!m_lastRequest)
+      return nullptr;
+    const Sampling::Viewport &view = m_lastRequest->viewport;
+    const Sampling::Feature *nearest = nullptr;
+    double best = radiusPx;
+    for (const auto &feature : features()) {
+      const double distance =
+          std::hypot((feature.at.x - x) * view.pixelsPerUnitX,
+                     (feature.at.y - y) * view.pixelsPerUnitY);
+      if (distance <= best) {
+        best = distance;
+        nearest = &feature;
       }
     }
+    return nearest;
+  }
+
+  /// Names a feature after the curves it lies on, numbered as entered.
+  std::string describe(const Sampling::Feature &feature) const {
+    const std::size_t curve = m_inputs[feature.curve] + 1;
+    switch (feature.kind) {
+    case Sampling::Feature::Kind::Zero:
+      return fmt::format("Zero of #{}", curve);
+    case Sampling::Feature::Kind::Minimum:
+      return fmt::format("Minimum of #{}", curve);
+    case Sampling::Feature::Kind::Maximum:
+      return fmt::format("Maximum of #{}", curve);
+    case Sampling::Feature::Kind::Intersection:
+      return fmt::format("#{} meets #{}", curve,
+                         m_inputs[feature.other] + 1);
+    }
+    return {};
+  }
+
+  /// What produced the geometry draw() currently shows.
+  const Stats &stats() const { return m_stats[m_front]; }
+  /// True while the worker is sampling.
+  bool isBusy() const { return m_busy; }
+
+  /**
+   * @brief Picks up finished geometry and, if the view changed, starts a
+   * new job for it, cancelling the one in flight.
+   */
+  void update(const sf::View &view, const sf::Vector2u &windowSize) {
+    if (m_middle.load(std::memory_order_acquire) & kFresh)
+      m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~kFresh;
+
+    sf::Vector2f viewSize = view.getSize();
+    sf::Vector2f viewCenter = view.getCenter();
+
+    // World y grows downwards on screen, so the curve is plotted at -f(x).
+    Request request{};
+    request.viewport.xMin = viewCenter.x - viewSize.x / 2;
+    request.viewport.xMax = viewCenter.x + viewSize.x / 2;
+    request.viewport.yMin = -(viewCenter.y + viewSize.y / 2);
+    request.viewport.yMax = -(viewCenter.y - viewSize.y / 2);
+    request.viewport.pixelsPerUnitX = windowSize.x / viewSize.x;
+    request.viewport.pixelsPerUnitY = windowSize.y / viewSize.y;
+    request.mode = m_mode;
+    request.adaptive = m_adaptive;
+    request.features = m_showFeatures && !m_expressions.empty();
+    request.parameters = m_parameterValues;
+    if (request == m_lastRequest)
+      return;
+    m_lastRequest = request;
+
+    {
+      std::lock_guard lock(m_mutex);
+      m_job.request_stop();
+      m_job = std::stop_source{};
+      m_pending = request;
+    }
+    m_wake.notify_one();
+  }
+
+  void draw(sf::RenderWindow &window) const {
+    window.draw(m_buffers[m_front]);
+  }
+};
+
+class StatusLine {
+private:
+  sf::Text m_text;
+
+public:
+  StatusLine(const sf::Font &font) {
+    m_text.setFont(font);
+    m_text.setCharacterSize(14);
+    m_text.setFillColor(sf::Color::Black);
   }
 
-  void draw(sf::RenderWindow &window) const { window.draw(m_vertices); }
+  void setPosition(float x, float y) { m_text.setPosition(x, y); }
+  void setString(const std::string &text) { m_text.setString(text); }
+  void draw(sf::RenderWindow &window) const { window.draw(m_text); }
 };
 
 class CoordinateBox {
@@ -172,17 +826,27 @@ public:
     m_text.setFillColor(sf::Color::White);
   }
 
-  void update(const sf::RenderWindow &window, const sf::View &view) {
-    sf::Vector2f boxSize(150, 50);
-    m_box.setSize(boxSize);
+  /// Shows the cursor position, or the feature it hovers over in full.
+  void update(const sf::RenderWindow &window, const sf::View &view,
+              const GraphSet &graphs) {
     m_box.setPosition(10, 10); // Fixed position in the top-left corner
 
     sf::Vector2i pixelPos = sf::Mouse::getPosition(window);
     sf::Vector2f worldPos = window.mapPixelToCoords(pixelPos, view);
 
     std::ostringstream oss;
-    oss << "X: " << std::fixed << std::setprecision(2) << worldPos.x << "\n"
-        << "Y: " << std::fixed << std::setprecision(2) << -worldPos.y;
+    const Sampling::Feature *feature =
+        graphs.featureNear(worldPos.x, -worldPos.y, 8);
+    if (feature) {
+      m_box.setSize(sf::Vector2f(220, 70));
+      oss << graphs.describe(*feature) << "\n"
+          << "X: " << std::setprecision(12) << feature->at.x << "\n"
+          << "Y: " << std::setprecision(12) << feature->at.y;
+    } else {
+      m_box.setSize(sf::Vector2f(150, 50));
+      oss << "X: " << std::fixed << std::setprecision(2) << worldPos.x << "\n"
+          << "Y: " << std::fixed << std::setprecision(2) << -worldPos.y;
+    }
     m_text.setString(oss.str());
     m_text.setPosition(m_box.getPosition() + sf::Vector2f(5, 5));
   }
@@ -247,6 +911,229 @@ private:
   bool m_inputReady = false;
 };
 
+/**
+ * @class ParameterPanel
+ * @brief A slider for every parameter, in the top-right corner.
+ *
+ * Clicking or dragging along a track sets the value; clicking a name starts
+ * or stops sweeping that parameter back and forth across its range.
+ */
+class ParameterPanel {
+public:
+  ParameterPanel(const sf::Font &font) : m_font(font) {}
+
+  /// Shows sliders for `names`, keeping the values of names already shown.
+  void setParameters(const std::vector<std::string> &names) {
+    std::vector<double> values(names.size(), 1.0);
+    std::vector<int> directions(names.size(), 0);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      const auto it = std::find(m_names.begin(), m_names.end(), names[i]);
+      if (it == m_names.end())
+        continue;
+      values[i] = m_values[it - m_names.begin()];
+      directions[i] = m_directions[it - m_names.begin()];
+    }
+    m_names = names;
+    m_values = std::move(values);
+    m_directions = std::move(directions);
+    m_dragging = npos;
+  }
+
+  /// Whether the event was aimed at the panel, which then handled it.
+  bool handleEvent(const sf::Event &event, const sf::RenderWindow &window,
+                   const sf::View &uiView) {
+    if (event.type == sf::Event::MouseButtonReleased &&
+        m_dragging != npos) {
+      m_dragging = npos;
+      return true;
+    }
+    if (event.type == sf::Event::MouseMoved && m_dragging != npos) {
+      const sf::Vector2f at = window.mapPixelToCoords(
+          sf::Vector2i(event.mouseMove.x, event.mouseMove.y), uiView);
+      setFromTrack(m_dragging, at.x, uiView);
+      return true;
+    }
+    if (event.type != sf::Event::MouseButtonPressed ||
+        event.mouseButton.button != sf::Mouse::Left)
+      return false;
+
+    const sf::Vector2f at = window.mapPixelToCoords(
+        sf::Vector2i(event.mouseButton.x, event.mouseButton.y), uiView);
+    const float left = this->left(uiView);
+    const float row = (at.y - kTop) / kRowHeight;
+    if (at.x < left || at.x > left + kLabelWidth + kTrackWidth || row < 0 ||
+        row >= static_cast<float>(m_names.size()))
+      return false;
+    const auto i = static_cast<std::size_t>(row);
+    if (at.x < left + kLabelWidth) {
+      m_directions[i] = m_directions[i] == 0 ? 1 : 0;
+    } else {
+      m_directions[i] = 0;
+      m_dragging = i;
+      setFromTrack(i, at.x, uiView);
+    }
+    return true;
+  }
+
+  /// Starts sweeping every parameter, or stops them all if any is moving.
+  void toggleAnimation() {
+    const bool moving = std::any_of(m_directions.begin(), m_directions.end(),
+                                    [](int d) { return d != 0; });
+    std::fill(m_directions.begin(), m_directions.end(), moving ? 0 : 1);
+  }
+
+  /// Moves every swept parameter on by `seconds`, turning at the ends.
+  void advance(double seconds) {
+    const double step = (kMax - kMin) / kSweepSeconds * seconds;
+    for (std::size_t i = 0; i < m_values.size(); ++i) {
+      if (m_directions[i] == 0)
+        continue;
+      double value = m_values[i] + m_directions[i] * step;
+      if (value > kMax) {
+        value = 2 * kMax - value;
+        m_directions[i] = -1;
+      } else if (value < kMin) {
+        value = 2 * kMin - value;
+        m_directions[i] = 1;
+      }
+      m_values[i] = std::clamp(value, kMin, kMax);
+    }
+  }
+
+  const std::vector<double> &values() const { return m_values; }
+
+  void draw(sf::RenderWindow &window, const sf::View &uiView) const {
+    const float left = this->left(uiView);
+    sf::Text label;
+    label.setFont(m_font);
+    label.setCharacterSize(14);
+    sf::RectangleShape track(sf::Vector2f(kTrackWidth, 4));
+    track.setFillColor(sf::Color(180, 180, 180));
+    sf::RectangleShape knob(sf::Vector2f(8, 16));
+    knob.setOrigin(4, 8);
+    for (std::size_t i = 0; i < m_names.size(); ++i) {
+      const float y = kTop + static_cast<float>(i) * kRowHeight;
+      label.setFillColor(m_directions[i] != 0 ? sf::Color::Blue
+                                              : sf::Color::Black);
+      label.setString(fmt::format("{} = {:.2f}", m_names[i], m_values[i]));
+      label.setPosition(left, y);
+      window.draw(label);
+
+      const float trackY = y + kRowHeight / 2 - 2;
+      track.setPosition(left + kLabelWidth, trackY);
+      window.draw(track);
+      const double t = (m_values[i] - kMin) / (kMax - kMin);
+      knob.setPosition(left + kLabelWidth +
+                           static_cast<float>(t) * kTrackWidth,
+                       trackY + 2);
+      knob.setFillColor(m_dragging == i ? sf::Color::Blue
+                                        : sf::Color(80, 80, 80));
+      window.draw(knob);
+    }
+  }
+
+private:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+  static constexpr float kTop = 10;
+  static constexpr float kRowHeight = 28;
+  static constexpr float kLabelWidth = 110;
+  static constexpr float kTrackWidth = 200;
+  static constexpr double kMin = -5;
+  static constexpr double kMax = 5;
+  static constexpr double kSweepSeconds = 4; ///< Time to cross the range
+
+  static float left(const sf::View &uiView) {
+    return uiView.getSize().x - kLabelWidth - kTrackWidth - 20;
+  }
+
+  void setFromTrack(std::size_t i, float x, const sf::View &uiView) {
+    const double t =
+        std::clamp((x - left(uiView) - kLabelWidth) / kTrackWidth, 0.f, 1.f);
+    m_values[i] = kMin + t * (kMax - kMin);
+  }
+
+  const sf::Font &m_font;
+  std::vector<std::string> m_names{};
+  std::vector<double> m_values{};
+  std::vector<int> m_directions{}; ///< 1 or -1 while swept, else 0
+  std::size_t m_dragging{npos};
+};
+
+/**
+ * @class ProfilerOverlay
+ * @brief The median and 99th percentile time of every stage of the frame
+ * over the last `kFrames` frames, and the evaluations sampling spent per
+ * frame, in the bottom-right corner.
+ */
+class ProfilerOverlay {
+public:
+  static constexpr std::size_t kFrames = 120;
+  static constexpr int kRefreshFrames = 15; ///< Keeps the figures readable
+
+  ProfilerOverlay(const sf::Font &font) {
+    m_box.setFillColor(sf::Color(0, 0, 0, 160));
+    m_box.setOutlineColor(sf::Color::White);
+    m_box.setOutlineThickness(1);
+    m_text.setFont(font);
+    m_text.setCharacterSize(14);
+    m_text.setFillColor(sf::Color::White);
+  }
+
+  void toggle() {
+    m_visible = !m_visible;
+    m_frame = 0;
+  }
+
+  /// Summarizes the recorded frames while shown; call once per frame.
+  void update(const sf::View &uiView) {
+    if (!m_visible || m_frame++ % kRefreshFrames != 0)
+      return;
+    m_text.setString(Profiling::kEnabled ? summaryText()
+                                         : "Profiler compiled out\n"
+                                           "(configure with -DFNP_PROFILE=ON)");
+    const sf::FloatRect bounds = m_text.getLocalBounds();
+    m_box.setSize(sf::Vector2f(bounds.width + 16, bounds.height + 16));
+    m_box.setPosition(uiView.getSize() - m_box.getSize() -
+                      sf::Vector2f(10, 10));
+    m_text.setPosition(m_box.getPosition() + sf::Vector2f(8, 4));
+  }
+
+  void draw(sf::RenderWindow &window) const {
+    if (!m_visible)
+      return;
+    window.draw(m_box);
+    window.draw(m_text);
+  }
+
+private:
+  sf::RectangleShape m_box;
+  sf::Text m_text;
+  bool m_visible{};
+  int m_frame{};
+
+  static std::string summaryText() {
+    const Profiling::Summary summary =
+        Profiling::Profiler::instance().summarize(kFrames);
+    std::string text = fmt::format("{:<9}{:>9}{:>9}\n",
+                                   fmt::format("{} fr", summary.frames),
+                                   "p50 ms", "p99 ms");
+    for (std::size_t s = 0; s < Profiling::kStageCount; ++s) {
+      const auto stage = static_cast<Profiling::Stage>(s);
+      const Profiling::StageSummary &figures = summary.stages[s];
+      if (stage == Profiling::Stage::Evaluations)
+        continue;
+      if (figures.count == 0)
+        text += fmt::format("{:<9}{:>9}{:>9}\n", Profiling::name(stage), "-",
+                            "-");
+      else
+        text += fmt::format("{:<9}{:>9.2f}{:>9.2f}\n", Profiling::name(stage),
+                            figures.p50Ms, figures.p99Ms);
+    }
+    return text + fmt::format("{:.0f} evaluations/frame",
+                              summary.evaluationsPerFrame);
+  }
+};
+
 inline void drawAxes(sf::RenderWindow &window, const sf::View &view) {
   sf::VertexArray axes(sf::Lines, 4);
   sf::Vector2f viewSize = view.getSize();
@@ -277,13 +1164,51 @@ inline int draw(int argc, char *argv[]) {
     return 1;
   }
 
-  std::string initialExpression = (argc > 1) ? argv[1] : "x";
-  Graph graph(initialExpression);
+  std::vector<std::string> expressions{};
+  std::string tracePath{"fncxx_trace.json"};
+  bool traceAtExit = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--jit") {
+      Tokenizer::CompiledExpression::setDefaultBackend(
+          Tokenizer::CompiledExpression::Backend::Jit);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      // 1 keeps every frame serial and deterministic; 0 uses every core.
+      Tokenizer::ThreadPool::setSharedThreadCount(std::stoul(argv[++i]));
+    } else if (arg == "--trace" && i + 1 < argc) {
+      // Where F6 and exit write the profiler's Chrome trace.
+      tracePath = argv[++i];
+      traceAtExit = true;
+    } else {
+      expressions.push_back(arg);
+    }
+  }
+  if (expressions.empty())
+    expressions.push_back("x");
+  auto graphs = std::make_unique<GraphSet>(expressions);
   CoordinateBox coordBox(font);
   InputBox inputBox(font);
   inputBox.setPosition(10, window.getSize().y - 60);
 
   AxisSystem axisSystem(font);
+  StatusLine status(font);
+  status.setPosition(10, 70);
+  ParameterPanel parameters(font);
+  parameters.setParameters(graphs->parameters());
+  ProfilerOverlay profilerOverlay(font);
+  auto samplingMode = GraphSet::SamplingMode::Uniform;
+  bool showFeatures = false;
+  sf::Clock clock;
+
+  auto writeTrace = [&] {
+    if (!Profiling::kEnabled)
+      std::cerr << "Profiler compiled out; configure with -DFNP_PROFILE=ON"
+                << std::endl;
+    else if (Profiling::Profiler::instance().writeChromeTrace(tracePath))
+      std::cerr << "Wrote trace to " << tracePath << std::endl;
+    else
+      std::cerr << "Cannot write " << tracePath << std::endl;
+  };
 
   sf::View graphView(sf::FloatRect(-15.f, -11.25f, 30.f, 22.5f));
   sf::View uiView(sf::FloatRect(0, 0, 1200, 900));
@@ -291,62 +1216,135 @@ inline int draw(int argc, char *argv[]) {
   sf::Vector2f lastPos;
   bool isDragging = false;
 
+  FNP_PROFILE_THREAD("render");
   while (window.isOpen()) {
+    FNP_PROFILE_SCOPE(Frame);
     sf::Event event;
-    while (window.pollEvent(event)) {
-      if (event.type == sf::Event::Closed) {
-        window.close();
-      } else if (event.type == sf::Event::MouseButtonPressed) {
-        if (event.mouseButton.button == sf::Mouse::Left) {
-          isDragging = true;
-          lastPos = window.mapPixelToCoords(
-              sf::Vector2i(event.mouseButton.x, event.mouseButton.y),
-              graphView);
-        }
-      } else if (event.type == sf::Event::MouseButtonReleased) {
-        if (event.mouseButton.button == sf::Mouse::Left) {
-          isDragging = false;
-        }
-      } else if (event.type == sf::Event::MouseMoved) {
-        if (isDragging) {
-          sf::Vector2f newPos = window.mapPixelToCoords(
-              sf::Vector2i(event.mouseMove.x, event.mouseMove.y), graphView);
-          sf::Vector2f deltaPos = lastPos - newPos;
-          graphView.move(deltaPos);
-          lastPos = newPos;
-        }
-      } else if (event.type == sf::Event::MouseWheelScrolled) {
-        if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
-          float zoomFactor = (event.mouseWheelScroll.delta > 0) ? 0.9f : 1.1f;
-          graphView.zoom(zoomFactor);
+    {
+      FNP_PROFILE_SCOPE(Events);
+      while (window.pollEvent(event)) {
+        if (parameters.handleEvent(event, window, uiView))
+          continue;
+        if (event.type == sf::Event::Closed) {
+          window.close();
+        } else if (event.type == sf::Event::MouseButtonPressed) {
+          if (event.mouseButton.button == sf::Mouse::Left) {
+            isDragging = true;
+            lastPos = window.mapPixelToCoords(
+                sf::Vector2i(event.mouseButton.x, event.mouseButton.y),
+                graphView);
+          }
+        } else if (event.type == sf::Event::MouseButtonReleased) {
+          if (event.mouseButton.button == sf::Mouse::Left) {
+            isDragging = false;
+          }
+        } else if (event.type == sf::Event::MouseMoved) {
+          if (isDragging) {
+            sf::Vector2f newPos = window.mapPixelToCoords(
+                sf::Vector2i(event.mouseMove.x, event.mouseMove.y), graphView);
+            sf::Vector2f deltaPos = lastPos - newPos;
+            graphView.move(deltaPos);
+            lastPos = newPos;
+          }
+        } else if (event.type == sf::Event::MouseWheelScrolled) {
+          if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+            float zoomFactor = (event.mouseWheelScroll.delta > 0) ? 0.9f : 1.1f;
+            graphView.zoom(zoomFactor);
+          }
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F2) {
+          samplingMode = (samplingMode == GraphSet::SamplingMode::Uniform)
+                             ? GraphSet::SamplingMode::Adaptive
+                             : GraphSet::SamplingMode::Uniform;
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F3) {
+          showFeatures = !showFeatures;
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F4) {
+          parameters.toggleAnimation();
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F5) {
+          profilerOverlay.toggle();
+        } else if (event.type == sf::Event::KeyPressed &&
+                   event.key.code == sf::Keyboard::F6) {
+          writeTrace();
         }
-      }
 
-      inputBox.handleEvent(event);
+        inputBox.handleEvent(event);
+      }
     }
 
+    // Enter adds the typed expression to the plot; Enter on an empty box
+    // removes the last one added.
     if (inputBox.isInputReady()) {
-      graph = Graph(inputBox.getInput());
+      std::string input = inputBox.getInput();
+      auto next = expressions;
+      if (input.empty()) {
+        if (!next.empty())
+          next.pop_back();
+      } else {
+        next.push_back(input);
+      }
+      try {
+        FNP_PROFILE_SCOPE(Parse);
+        graphs = std::make_unique<GraphSet>(next);
+        expressions = std::move(next);
+        parameters.setParameters(graphs->parameters());
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+      }
       inputBox.clear();
     }
 
-    graph.calculatePoints(graphView);
-    coordBox.update(window, graphView);
-    axisSystem.update(graphView, window.getSize());
+    graphs->setSamplingMode(samplingMode);
+    graphs->setShowFeatures(showFeatures);
+    parameters.advance(clock.restart().asSeconds());
+    graphs->setParameters(parameters.values());
+    graphs->update(graphView, window.getSize());
+    const GraphSet::Stats &stats = graphs->stats();
+    status.setString(fmt::format(
+        "{} sampling (F2): {} curves, {} samples on {} threads, {} tiles "
+        "cached ({} KiB), {}{}{}",
+        samplingMode == GraphSet::SamplingMode::Adaptive ? "Adaptive"
+                                                         : "Uniform",
+        graphs->size(), stats.samples,
+        Tokenizer::ThreadPool::shared().threadCount(), stats.tiles,
+        stats.tileBytes / 1024,
+        showFeatures ? fmt::format("{} features (F3)", stats.features)
+                     : std::string("features off (F3)"),
+        stats.nodes > 0 ? fmt::format(", {}/{} nodes recomputed",
+                                      stats.recomputed, stats.nodes)
+                        : std::string(),
+        graphs->isBusy() ? " - updating" : ""));
+    coordBox.update(window, graphView, *graphs);
+    profilerOverlay.update(uiView);
+    {
+      FNP_PROFILE_SCOPE(Axes);
+      axisSystem.update(graphView, window.getSize());
+    }
 
-    window.clear(sf::Color::White);
+    {
+      FNP_PROFILE_SCOPE(Submit);
+      window.clear(sf::Color::White);
 
-    // Draw graph and axes
-    window.setView(graphView);
-    axisSystem.draw(window);
-    graph.draw(window);
+      // Draw graph and axes
+      window.setView(graphView);
+      axisSystem.draw(window);
+      graphs->draw(window);
 
-    // Draw UI elements
-    window.setView(uiView);
-    coordBox.draw(window);
-    inputBox.draw(window);
+      // Draw UI elements
+      window.setView(uiView);
+      coordBox.draw(window);
+      status.draw(window);
+      parameters.draw(window, uiView);
+      inputBox.draw(window);
+      profilerOverlay.draw(window);
+    }
 
+    FNP_PROFILE_SCOPE(Display);
     window.display();
   }
+  if (traceAtExit)
+    writeTrace();
   return 0;
 }
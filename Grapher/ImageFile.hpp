@@ -0,0 +1,290 @@
+#pragma once
+#include "Raster.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Raster {
+
+namespace detail {
+
+inline std::uint32_t crc32(const std::uint8_t *data, std::size_t size,
+                           std::uint32_t crc = 0) {
+  static const auto table = [] {
+    std::array<std::uint32_t, 256> entries{};
+    for (std::uint32_t n = 0; n < 256; ++n) {
+      std::uint32_t c = n;
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      entries[n] = c;
+    }
+    return entries;
+  }();
+  crc = ~crc;
+  for (std::size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+inline std::uint32_t adler32(const std::uint8_t *data, std::size_t size) {
+  std::uint32_t a = 1, b = 0;
+  while (size > 0) {
+    // The largest run whose sums cannot overflow before the modulo.
+    const std::size_t run = std::min<std::size_t>(size, 5552);
+    for (std::size_t i = 0; i < run; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += run;
+    size -= run;
+  }
+  return b << 16 | a;
+}
+
+/// Writes bits least significant first, as deflate packs them.
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<std::uint8_t> &out) : m_out(out) {}
+
+  void bits(std::uint32_t value, int count) {
+    m_buffer |= static_cast<std::uint64_t>(value) << m_count;
+    m_count += count;
+    while (m_count >= 8) {
+      m_out.push_back(static_cast<std::uint8_t>(m_buffer));
+      m_buffer >>= 8;
+      m_count -= 8;
+    }
+  }
+
+  /// A Huffman code, which deflate stores most significant bit first.
+  void code(std::uint32_t code, int length) {
+    std::uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i, code >>= 1)
+      reversed = reversed << 1 | (code & 1);
+    bits(reversed, length);
+  }
+
+  void flush() {
+    if (m_count > 0)
+      m_out.push_back(static_cast<std::uint8_t>(m_buffer));
+    m_buffer = 0;
+    m_count = 0;
+  }
+
+private:
+  std::vector<std::uint8_t> &m_out;
+  std::uint64_t m_buffer{};
+  int m_count{};
+};
+
+// A literal or length symbol in the fixed Huffman code.
+inline void fixedLiteral(BitWriter &writer, std::uint32_t symbol) {
+  if (symbol < 144)
+    writer.code(0x30 + symbol, 8);
+  else if (symbol < 256)
+    writer.code(0x190 + symbol - 144, 9);
+  else if (symbol < 280)
+    writer.code(symbol - 256, 7);
+  else
+    writer.code(0xc0 + symbol - 280, 8);
+}
+
+inline void fixedMatch(BitWriter &writer, std::size_t length,
+                       std::size_t distance) {
+  static constexpr std::uint16_t kLengthBase[] = {
+      3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr std::uint8_t kLengthExtra[] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static constexpr std::uint16_t kDistanceBase[] = {
+      1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+      33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+      1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+  static constexpr std::uint8_t kDistanceExtra[] = {
+      0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  std::size_t l = std::size(kLengthBase) - 1;
+  while (kLengthBase[l] > length)
+    --l;
+  fixedLiteral(writer, static_cast<std::uint32_t>(257 + l));
+  writer.bits(static_cast<std::uint32_t>(length - kLengthBase[l]),
+              kLengthExtra[l]);
+
+  std::size_t d = std::size(kDistanceBase) - 1;
+  while (kDistanceBase[d] > distance)
+    --d;
+  writer.code(static_cast<std::uint32_t>(d), 5);
+  writer.bits(static_cast<std::uint32_t>(distance - kDistanceBase[d]),
+              kDistanceExtra[d]);
+}
+
+/**
+ * @brief Compresses `data` into a zlib stream of one fixed-Huffman deflate
+ * block.
+ *
+ * Matches are found through a table of the last position of every 3-byte
+ * hash, without chains. That is weak on text, but filtered plot rows are
+ * long runs of zeros and repeats a row or a pixel back, which it finds.
+ */
+inline void zlibCompress(const std::vector<std::uint8_t> &data,
+                         std::vector<std::uint8_t> &out) {
+  constexpr std::size_t kMinMatch = 3, kMaxMatch = 258, kWindow = 32768;
+  constexpr int kHashBits = 15;
+  constexpr std::size_t kNone = ~std::size_t{0};
+  constexpr std::size_t kTail = 8;
+
+  out.push_back(0x78);
+  out.push_back(0x01);
+  BitWriter writer(out);
+  writer.bits(1, 1); // Last block
+  writer.bits(1, 2); // Fixed Huffman codes
+
+  std::vector<std::size_t> head(std::size_t{1} << kHashBits, kNone);
+  auto hash = [&](std::size_t at) {
+    const std::uint32_t key = std::uint32_t{data[at]} |
+                              std::uint32_t{data[at + 1]} << 8 |
+                              std::uint32_t{data[at + 2]} << 16;
+    return (key * 2654435761u) >> (32 - kHashBits);
+  };
+  const std::size_t size = data.size();
+  std::size_t at = 0;
+  while (at < size) {
+    std::size_t length = 0, distance = 0;
+    if (at + kMinMatch <= size) {
+      const auto h = hash(at);
+      const std::size_t candidate = head[h];
+      head[h] = at;
+      if (candidate != kNone && at - candidate <= kWindow) {
+        const std::size_t limit = std::min(kMaxMatch, size - at);
+        const std::uint8_t *a = data.data() + candidate;
+        const std::uint8_t *b = data.data() + at;
+        while (length + 8 <= limit &&
+               std::memcmp(a + length, b + length, 8) == 0)
+          length += 8;
+        while (length < limit && a[length] == b[length])
+          ++length;
+        distance = at - candidate;
+      }
+    }
+    if (length < kMinMatch) {
+      fixedLiteral(writer, data[at]);
+      ++at;
+      continue;
+    }
+    fixedMatch(writer, length, distance);
+    // Only the end of a match is indexed: what follows a long run is most
+    // often more of the same run, which the end of it finds.
+    const std::size_t tail = at + length - std::min(length - 1, kTail);
+    for (std::size_t i = tail; i < at + length && i + kMinMatch <= size; ++i)
+      head[hash(i)] = i;
+    at += length;
+  }
+  fixedLiteral(writer, 256); // End of block
+  writer.flush();
+
+  const std::uint32_t adler = adler32(data.data(), data.size());
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(static_cast<std::uint8_t>(adler >> shift));
+}
+
+inline void putChunk(std::vector<std::uint8_t> &out, const char type[4],
+                     const std::vector<std::uint8_t> &payload) {
+  const auto size = static_cast<std::uint32_t>(payload.size());
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(static_cast<std::uint8_t>(size >> shift));
+  const std::size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), payload.begin(), payload.end());
+  const std::uint32_t crc = crc32(out.data() + start, out.size() - start);
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(static_cast<std::uint8_t>(crc >> shift));
+}
+
+} // namespace detail
+
+/**
+ * @brief Encodes the image as a binary PPM (P6).
+ */
+inline std::vector<std::uint8_t> encodePpm(const Image &image) {
+  const std::string header = "P6\n" + std::to_string(image.width) + " " +
+                             std::to_string(image.height) + "\n255\n";
+  std::vector<std::uint8_t> out(header.begin(), header.end());
+  out.insert(out.end(), image.pixels.begin(), image.pixels.end());
+  return out;
+}
+
+/**
+ * @brief Encodes the image as an 8-bit RGB PNG.
+ *
+ * Every row but the first is stored as its difference from the row above,
+ * which turns the plain background and the grid into runs of zeros for
+ * the compressor.
+ */
+inline std::vector<std::uint8_t> encodePng(const Image &image) {
+  const std::size_t stride = 3 * image.width;
+  std::vector<std::uint8_t> filtered((stride + 1) * image.height);
+  for (std::size_t y = 0; y < image.height; ++y) {
+    const std::uint8_t *row = image.pixels.data() + y * stride;
+    std::uint8_t *out = filtered.data() + y * (stride + 1);
+    if (y == 0) {
+      out[0] = 0; // None
+      std::copy_n(row, stride, out + 1);
+      continue;
+    }
+    out[0] = 2; // Up
+    for (std::size_t i = 0; i < stride; ++i)
+      out[1 + i] = static_cast<std::uint8_t>(row[i] - row[i - stride]);
+  }
+
+  std::vector<std::uint8_t> header(13);
+  const auto width = static_cast<std::uint32_t>(image.width);
+  const auto height = static_cast<std::uint32_t>(image.height);
+  for (int i = 0; i < 4; ++i) {
+    header[i] = static_cast<std::uint8_t>(width >> (24 - 8 * i));
+    header[4 + i] = static_cast<std::uint8_t>(height >> (24 - 8 * i));
+  }
+  header[8] = 8; // Bits per channel
+  header[9] = 2; // RGB
+
+  std::vector<std::uint8_t> compressed{};
+  compressed.reserve(filtered.size() / 8);
+  detail::zlibCompress(filtered, compressed);
+
+  static constexpr std::uint8_t kSignature[] = {0x89, 'P',  'N',  'G',
+                                                0x0d, 0x0a, 0x1a, 0x0a};
+  std::vector<std::uint8_t> out(std::begin(kSignature), std::end(kSignature));
+  detail::putChunk(out, "IHDR", header);
+  detail::putChunk(out, "IDAT", compressed);
+  detail::putChunk(out, "IEND", {});
+  return out;
+}
+
+/**
+ * @brief Writes the image to a file, as PPM if its name ends in `.ppm` and
+ * as PNG otherwise.
+ * @return false if the file could not be written.
+ */
+inline bool writeImage(const Image &image, const std::string &path) {
+  const bool ppm =
+      path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+  const std::vector<std::uint8_t> bytes =
+      ppm ? encodePpm(image) : encodePng(image);
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  const bool written =
+      std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  return std::fclose(file) == 0 && written;
+}
+
+} // namespace Raster
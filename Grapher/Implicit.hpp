@@ -0,0 +1,264 @@
+#pragma once
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+#include "Sampling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <stop_token>
+#include <vector>
+
+namespace Sampling {
+
+/**
+ * @brief A piece of a contour.
+ */
+struct Segment {
+  Point a{};
+  Point b{};
+};
+
+/**
+ * @brief Resolution of implicit curves.
+ */
+struct ImplicitSettings {
+  double cellPx{4};          ///< Width and height of a grid cell
+  std::size_t leafCells{8};  ///< Side of the blocks that are contoured
+  std::size_t tileCells{64}; ///< Side of the blocks sampled in parallel
+
+  bool operator==(const ImplicitSettings &other) const = default;
+};
+
+namespace detail {
+
+class ImplicitContourer {
+public:
+  ImplicitContourer(const Tokenizer::CompiledExpression &expr,
+                    const Viewport &view, const ImplicitSettings &settings)
+      : m_expr(expr), m_view(view), m_settings(settings) {
+    const double widthPx = (view.xMax - view.xMin) * view.pixelsPerUnitX;
+    const double heightPx = (view.yMax - view.yMin) * view.pixelsPerUnitY;
+    m_columns = static_cast<std::size_t>(
+        std::clamp(std::ceil(widthPx / settings.cellPx), 1.0, 16384.0));
+    m_rows = static_cast<std::size_t>(
+        std::clamp(std::ceil(heightPx / settings.cellPx), 1.0, 16384.0));
+    m_dx = (view.xMax - view.xMin) / static_cast<double>(m_columns);
+    m_dy = (view.yMax - view.yMin) / static_cast<double>(m_rows);
+  }
+
+  std::size_t columns() const { return m_columns; }
+  std::size_t rows() const { return m_rows; }
+
+  // Contours the cells [c0, c0 + size) x [r0, r0 + size), clipped to the
+  // grid, skipping every quadrant that provably holds no zero.
+  std::size_t run(std::size_t c0, std::size_t r0, std::size_t size,
+                  std::vector<Segment> &out) const {
+    const std::size_t c1 = std::min(c0 + size, m_columns);
+    const std::size_t r1 = std::min(r0 + size, m_rows);
+    if (c0 >= c1 || r0 >= r1)
+      return 0;
+    if (!mayVanish(box(c0, c1, r0, r1)))
+      return 0;
+    if (size <= m_settings.leafCells)
+      return march(c0, c1, r0, r1, out);
+
+    const std::size_t half = size / 2;
+    return run(c0, r0, half, out) + run(c0 + half, r0, half, out) +
+           run(c0, r0 + half, half, out) +
+           run(c0 + half, r0 + half, half, out);
+  }
+
+private:
+  // Every grid line is computed from its index alone, so blocks that share
+  // an edge see the same corners and their segments join exactly.
+  double xAt(std::size_t c) const {
+    return m_view.xMin + static_cast<double>(c) * m_dx;
+  }
+  double yAt(std::size_t r) const {
+    return m_view.yMin + static_cast<double>(r) * m_dy;
+  }
+
+  Tokenizer::Interval box(std::size_t c0, std::size_t c1, std::size_t r0,
+                          std::size_t r1) const {
+    return m_expr.evalInterval({xAt(c0), xAt(c1)}, {yAt(r0), yAt(r1)});
+  }
+
+  static bool mayVanish(const Tokenizer::Interval &range) {
+    return range.lo <= 0 && 0 <= range.hi;
+  }
+
+  // Runs marching squares over a block; the corners are evaluated a row
+  // at a time.
+  std::size_t march(std::size_t c0, std::size_t c1, std::size_t r0,
+                    std::size_t r1, std::vector<Segment> &out) const {
+    const std::size_t w = c1 - c0 + 1;
+    const std::size_t h = r1 - r0 + 1;
+    double xs[Tokenizer::CompiledExpression::kBatchSize];
+    thread_local std::vector<double> values{};
+    values.resize(w * h);
+    for (std::size_t i = 0; i < w; ++i)
+      xs[i] = xAt(c0 + i);
+    for (std::size_t j = 0; j < h; ++j)
+      m_expr.evalBatch({xs, w}, yAt(r0 + j), {values.data() + j * w, w});
+
+    for (std::size_t j = 0; j + 1 < h; ++j) {
+      for (std::size_t i = 0; i + 1 < w; ++i) {
+        // Corners counter-clockwise from the bottom left.
+        const double f[4] = {values[j * w + i], values[j * w + i + 1],
+                             values[(j + 1) * w + i + 1],
+                             values[(j + 1) * w + i]};
+        if (!std::isfinite(f[0]) || !std::isfinite(f[1]) ||
+            !std::isfinite(f[2]) || !std::isfinite(f[3]))
+          continue;
+        const unsigned mask = (f[0] > 0) | (f[1] > 0) << 1 | (f[2] > 0) << 2 |
+                              (f[3] > 0) << 3;
+        if (mask == 0 || mask == 15)
+          continue;
+        // A sign change across a pole is not a zero.
+        const std::size_t c = c0 + i;
+        const std::size_t r = r0 + j;
+        if (!box(c, c + 1, r, r + 1).isBounded())
+          continue;
+        cell(c, r, f, mask, out);
+      }
+    }
+    return w * h;
+  }
+
+  // Emits the segments of one cell. Edge k runs from corner k to corner
+  // k + 1.
+  void cell(std::size_t c, std::size_t r, const double (&f)[4],
+            unsigned mask, std::vector<Segment> &out) const {
+    const Point corner[4] = {{xAt(c), yAt(r)},
+                             {xAt(c + 1), yAt(r)},
+                             {xAt(c + 1), yAt(r + 1)},
+                             {xAt(c), yAt(r + 1)}};
+    auto edge = [&](int k) {
+      const int l = (k + 1) % 4;
+      const double t = f[k] / (f[k] - f[l]);
+      return Point{corner[k].x + t * (corner[l].x - corner[k].x),
+                   corner[k].y + t * (corner[l].y - corner[k].y)};
+    };
+    auto emit = [&](int from, int to) {
+      out.push_back({edge(from), edge(to)});
+    };
+
+    // Saddles are split the way the value at the centre says.
+    const bool centre = f[0] + f[1] + f[2] + f[3] > 0;
+    switch (mask) {
+    case 1:
+    case 14:
+      emit(3, 0);
+      break;
+    case 2:
+    case 13:
+      emit(0, 1);
+      break;
+    case 3:
+    case 12:
+      emit(3, 1);
+      break;
+    case 4:
+    case 11:
+      emit(1, 2);
+      break;
+    case 6:
+    case 9:
+      emit(0, 2);
+      break;
+    case 7:
+    case 8:
+      emit(2, 3);
+      break;
+    case 5:
+      if (centre) {
+        emit(0, 1);
+        emit(2, 3);
+      } else {
+        emit(3, 0);
+        emit(1, 2);
+      }
+      break;
+    case 10:
+      if (centre) {
+        emit(3, 0);
+        emit(1, 2);
+      } else {
+        emit(0, 1);
+        emit(2, 3);
+      }
+      break;
+    }
+  }
+
+  const Tokenizer::CompiledExpression &m_expr;
+  const Viewport &m_view;
+  const ImplicitSettings &m_settings;
+  std::size_t m_columns{};
+  std::size_t m_rows{};
+  double m_dx{};
+  double m_dy{};
+};
+
+} // namespace detail
+
+/**
+ * @brief Contours the implicit curve f(x, y) = 0 across the viewport.
+ *
+ * The view is covered by a grid of `cellPx` pixel cells, split into
+ * `tileCells` square tiles that are contoured in parallel. Each tile is a
+ * quadtree: a quadrant whose interval bound excludes zero is dropped
+ * whole, and the quadrants left at `leafCells` are evaluated a grid row at
+ * a time and run through marching squares. Only cells near the curve are
+ * ever evaluated, so the cost follows the length of the curve rather than
+ * the area of the view. Cells whose bound is unbounded are taken to hold a
+ * pole rather than a zero.
+ *
+ * @param stop Once requested, no further tiles are contoured and `out` is
+ * incomplete.
+ * @return The number of evaluations.
+ */
+inline std::size_t contourImplicit(const Tokenizer::CompiledExpression &expr,
+                                   const Viewport &view,
+                                   const ImplicitSettings &settings,
+                                   std::vector<Segment> &out,
+                                   Tokenizer::ThreadPool *pool = nullptr,
+                                   const std::stop_token &stop = {}) {
+  // A leaf's corner row has to fit in one batch.
+  ImplicitSettings clamped = settings;
+  clamped.leafCells = std::clamp<std::size_t>(
+      std::bit_floor(std::max<std::size_t>(settings.leafCells, 1)), 1,
+      Tokenizer::CompiledExpression::kBatchSize / 2);
+  clamped.tileCells = std::max(std::bit_ceil(settings.tileCells),
+                               clamped.leafCells);
+
+  const detail::ImplicitContourer contourer(expr, view, clamped);
+  const std::size_t across =
+      (contourer.columns() + clamped.tileCells - 1) / clamped.tileCells;
+  const std::size_t down =
+      (contourer.rows() + clamped.tileCells - 1) / clamped.tileCells;
+
+  std::vector<std::vector<Segment>> tiles(across * down);
+  std::atomic<std::size_t> evaluations{0};
+  auto contourRange = [&](std::size_t begin, std::size_t end) {
+    std::size_t spent = 0;
+    for (std::size_t t = begin; t < end && !stop.stop_requested(); ++t)
+      spent += contourer.run((t % across) * clamped.tileCells,
+                             (t / across) * clamped.tileCells,
+                             clamped.tileCells, tiles[t]);
+    evaluations.fetch_add(spent, std::memory_order_relaxed);
+  };
+  if (pool)
+    pool->parallelFor(tiles.size(), 1, contourRange);
+  else
+    contourRange(0, tiles.size());
+
+  for (const auto &tile : tiles)
+    out.insert(out.end(), tile.begin(), tile.end());
+  return evaluations;
+}
+
+} // namespace Sampling
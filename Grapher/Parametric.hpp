@@ -0,0 +1,201 @@
+#pragma once
+#include "../functionParser/CompiledExpression.hpp"
+#include "Sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+namespace Sampling {
+
+/**
+ * @brief Parameter range and resolution of parametric and polar curves.
+ */
+struct ParametricSettings {
+  double tMin{0};
+  double tMax{2 * std::numbers::pi};
+  std::size_t initialSamples{256}; ///< Parameter values sampled up front
+  double spacingPx{3};             ///< Longest segment wanted on screen
+  int maxPasses{10};               ///< Times one interval may be split
+  std::size_t maxSamples{1 << 16}; ///< Parameter values sampled in total
+
+  bool operator==(const ParametricSettings &other) const = default;
+};
+
+namespace detail {
+
+/// Largest number of samples put into one interval per pass.
+inline constexpr std::size_t kMaxSplit = 64;
+/// Segments still this many times too long after the last pass are jumps.
+inline constexpr double kJumpFactor = 8;
+
+/**
+ * Samples a path given by `eval(ts, n, points)`, which maps `n` parameter
+ * values to points in one batch.
+ */
+template <class Eval>
+std::size_t samplePath(const Eval &eval, const Viewport &view,
+                       const ParametricSettings &settings,
+                       std::vector<Point> &out) {
+  constexpr std::size_t kBatch = Tokenizer::CompiledExpression::kBatchSize;
+  auto evalAll = [&](const std::vector<double> &ts, std::vector<Point> &pts) {
+    pts.resize(ts.size());
+    for (std::size_t base = 0; base < ts.size(); base += kBatch)
+      eval(ts.data() + base, std::min(kBatch, ts.size() - base),
+           pts.data() + base);
+  };
+  auto lengthPx = [&](const Point &a, const Point &b) {
+    return std::hypot((b.x - a.x) * view.pixelsPerUnitX,
+                      (b.y - a.y) * view.pixelsPerUnitY);
+  };
+  auto isFinite = [](const Point &p) {
+    return std::isfinite(p.x) && std::isfinite(p.y);
+  };
+  // Segments with both ends a whole view beyond the same edge are not
+  // refined.
+  const double marginX = view.xMax - view.xMin;
+  const double marginY = view.yMax - view.yMin;
+  auto isFarOff = [&](const Point &a, const Point &b) {
+    return (a.x < view.xMin - marginX && b.x < view.xMin - marginX) ||
+           (a.x > view.xMax + marginX && b.x > view.xMax + marginX) ||
+           (a.y < view.yMin - marginY && b.y < view.yMin - marginY) ||
+           (a.y > view.yMax + marginY && b.y > view.yMax + marginY);
+  };
+
+  const std::size_t intervals =
+      std::max<std::size_t>(settings.initialSamples, 1);
+  std::vector<double> ts(intervals + 1);
+  for (std::size_t i = 0; i <= intervals; ++i)
+    ts[i] = settings.tMin + (settings.tMax - settings.tMin) *
+                                static_cast<double>(i) /
+                                static_cast<double>(intervals);
+  std::vector<Point> pts{};
+  evalAll(ts, pts);
+  std::vector<int> depth(ts.size(), 0); ///< Of the interval after each value
+  std::size_t samples = ts.size();
+
+  // Every pass splits each interval into as many pieces as its length on
+  // screen calls for, and evaluates all the new parameter values in one
+  // batch. An interval with one undefined end is halved towards the edge
+  // of the domain. An interval is split at most `maxPasses` times.
+  std::vector<std::size_t> splits{};
+  std::vector<double> newTs{}, mergedTs{};
+  std::vector<Point> newPts{}, mergedPts{};
+  std::vector<int> mergedDepth{};
+  while (samples < settings.maxSamples) {
+    splits.assign(ts.size() - 1, 0);
+    newTs.clear();
+    for (std::size_t i = 0; i + 1 < ts.size(); ++i) {
+      const Point &a = pts[i];
+      const Point &b = pts[i + 1];
+      if (depth[i] >= settings.maxPasses)
+        continue;
+      std::size_t k = 0;
+      if (isFinite(a) && isFinite(b) && !isFarOff(a, b)) {
+        const double pieces = std::ceil(lengthPx(a, b) / settings.spacingPx);
+        k = static_cast<std::size_t>(
+            std::clamp(pieces - 1, 0.0, static_cast<double>(kMaxSplit)));
+      } else if (isFinite(a) != isFinite(b)) {
+        k = 1;
+      }
+      k = std::min(k, settings.maxSamples - std::min(settings.maxSamples,
+                                                     samples + newTs.size()));
+      for (std::size_t j = 1; j <= k; ++j)
+        newTs.push_back(ts[i] + (ts[i + 1] - ts[i]) * static_cast<double>(j) /
+                                    static_cast<double>(k + 1));
+      splits[i] = k;
+    }
+    if (newTs.empty())
+      break;
+    evalAll(newTs, newPts);
+    samples += newTs.size();
+
+    mergedTs.clear();
+    mergedPts.clear();
+    mergedDepth.clear();
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < ts.size(); ++i) {
+      const int d = depth[i] + (i < splits.size() && splits[i] > 0);
+      mergedTs.push_back(ts[i]);
+      mergedPts.push_back(pts[i]);
+      mergedDepth.push_back(d);
+      for (std::size_t j = 0; i < splits.size() && j < splits[i]; ++j) {
+        mergedTs.push_back(newTs[next]);
+        mergedPts.push_back(newPts[next]);
+        mergedDepth.push_back(d);
+        ++next;
+      }
+    }
+    std::swap(ts, mergedTs);
+    std::swap(pts, mergedPts);
+    std::swap(depth, mergedDepth);
+  }
+
+  // An interval split `maxPasses` times that is still far too long spans a
+  // jump, e.g. across a pole, and the segment over it is not part of the
+  // curve.
+  for (std::size_t i = 0; i < pts.size(); ++i) {
+    if (i > 0 && depth[i - 1] >= settings.maxPasses &&
+        lengthPx(pts[i - 1], pts[i]) > kJumpFactor * settings.spacingPx)
+      out.push_back({pts[i].x, std::numeric_limits<double>::quiet_NaN()});
+    out.push_back(pts[i]);
+  }
+  return samples;
+}
+
+} // namespace detail
+
+/**
+ * @brief Samples the curve (x(t), y(t)) for t in [tMin, tMax].
+ *
+ * Both coordinates are evaluated together, a batch of parameter values at
+ * a time. Sampling starts from `initialSamples` equal steps of t and then
+ * adapts to arc length on screen: each pass splits every segment longer
+ * than `spacingPx` pixels into as many pieces as its length calls for,
+ * until none is left or `maxSamples` is spent. A stretch still too long
+ * after `maxPasses` splits is taken to be a jump and breaks the curve, and
+ * stretches a whole view beyond one edge of it are not refined.
+ *
+ * @param x, y Expressions compiled with `t` as their variable.
+ * @return The number of evaluations.
+ */
+inline std::size_t sampleParametric(const Tokenizer::CompiledExpression &x,
+                                    const Tokenizer::CompiledExpression &y,
+                                    const Viewport &view,
+                                    const ParametricSettings &settings,
+                                    std::vector<Point> &out) {
+  auto eval = [&](const double *ts, std::size_t n, Point *points) {
+    double xs[Tokenizer::CompiledExpression::kBatchSize];
+    double ys[Tokenizer::CompiledExpression::kBatchSize];
+    x.evalBatch({ts, n}, {xs, n});
+    y.evalBatch({ts, n}, {ys, n});
+    for (std::size_t i = 0; i < n; ++i)
+      points[i] = {xs[i], ys[i]};
+  };
+  return 2 * detail::samplePath(eval, view, settings, out);
+}
+
+/**
+ * @brief Samples the polar curve r(t) for t in [tMin, tMax], adapting to
+ * arc length on screen like `sampleParametric()`.
+ *
+ * @param r An expression compiled with `t` as its variable.
+ * @return The number of evaluations.
+ */
+inline std::size_t samplePolar(const Tokenizer::CompiledExpression &r,
+                               const Viewport &view,
+                               const ParametricSettings &settings,
+                               std::vector<Point> &out) {
+  auto eval = [&](const double *ts, std::size_t n, Point *points) {
+    double rs[Tokenizer::CompiledExpression::kBatchSize];
+    r.evalBatch({ts, n}, {rs, n});
+    for (std::size_t i = 0; i < n; ++i)
+      points[i] = {rs[i] * std::cos(ts[i]), rs[i] * std::sin(ts[i])};
+  };
+  return detail::samplePath(eval, view, settings, out);
+}
+
+} // namespace Sampling
@@ -0,0 +1,382 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scoped stage timers. Without FNP_PROFILE the macros expand to nothing,
+// so a build without it neither times nor records anything.
+#ifdef FNP_PROFILE
+#define FNP_PROFILE_CONCAT_(a, b) a##b
+#define FNP_PROFILE_CONCAT(a, b) FNP_PROFILE_CONCAT_(a, b)
+/// Times the rest of the enclosing block as the given `Profiling::Stage`.
+#define FNP_PROFILE_SCOPE(stage)                                               \
+  ::Profiling::Scope FNP_PROFILE_CONCAT(fnpProfileScope, __LINE__)(           \
+      ::Profiling::Stage::stage)
+/// Records an amount, such as `Evaluations`, at this moment.
+#define FNP_PROFILE_COUNT(stage, amount)                                       \
+  ::Profiling::count(::Profiling::Stage::stage, amount)
+/// Names the calling thread in the trace.
+#define FNP_PROFILE_THREAD(name)                                               \
+  ::Profiling::Profiler::instance().nameThread(name)
+#else
+#define FNP_PROFILE_SCOPE(stage) static_cast<void>(0)
+#define FNP_PROFILE_COUNT(stage, amount) static_cast<void>(0)
+#define FNP_PROFILE_THREAD(name) static_cast<void>(0)
+#endif
+
+namespace Profiling {
+
+/// Whether the profiler was compiled in.
+#ifdef FNP_PROFILE
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+/// What an event measures.
+enum class Stage : std::uint8_t {
+  Frame,       ///< One pass of the main loop
+  Events,      ///< Handling window events
+  Parse,       ///< Compiling the expressions
+  Sample,      ///< A job of the sampling worker
+  Axes,        ///< `AxisSystem::update()`
+  Submit,      ///< Handing the geometry to the window
+  Display,     ///< `display()`, including the wait for the next frame
+  Evaluations, ///< Not a time: the evaluations a sampling job spent
+  Count
+};
+
+inline constexpr std::size_t kStageCount =
+    static_cast<std::size_t>(Stage::Count);
+
+inline constexpr std::string_view kStageNames[kStageCount] = {
+    "frame", "events", "parse",  "sample",
+    "axes",  "submit", "display", "evaluations"};
+
+inline std::string_view name(Stage stage) {
+  return kStageNames[static_cast<std::size_t>(stage)];
+}
+
+struct Event {
+  Stage stage{};
+  std::uint64_t startNs{}; ///< Since the profiler started
+  std::uint64_t amount{};  ///< Duration in ns, or the count it records
+};
+
+/**
+ * @class Ring
+ * @brief The last `kCapacity` events of one thread.
+ *
+ * Only the owning thread pushes, and it never waits: a push is a few
+ * relaxed stores between two counters. `snapshot()` can run on any thread
+ * at the same time. It copies the slots and then drops any the owner may
+ * have started to overwrite meanwhile, as a sequence lock would.
+ */
+class Ring {
+public:
+  static constexpr std::size_t kCapacity = 4096;
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+                "Slots are picked by masking the index");
+
+  void push(Stage stage, std::uint64_t startNs,
+            std::uint64_t amount) noexcept {
+    const std::uint64_t index = m_published.load(std::memory_order_relaxed);
+    m_begun.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = m_slots[index & (kCapacity - 1)];
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.packed.store(static_cast<std::uint64_t>(stage) << kStageShift |
+                          (amount & kAmountMask),
+                      std::memory_order_relaxed);
+    m_published.store(index + 1, std::memory_order_release);
+  }
+
+  /// Appends the events held, oldest first.
+  void snapshot(std::vector<Event> &out) const {
+    const std::uint64_t end = m_published.load(std::memory_order_acquire);
+    const std::uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    const std::size_t base = out.size();
+    for (std::uint64_t i = begin; i < end; ++i) {
+      const Slot &slot = m_slots[i & (kCapacity - 1)];
+      const std::uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+      out.push_back({static_cast<Stage>(packed >> kStageShift),
+                     slot.startNs.load(std::memory_order_relaxed),
+                     packed & kAmountMask});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Pushes since `end` may have overwritten the oldest slots.
+    const std::uint64_t begun = m_begun.load(std::memory_order_relaxed);
+    const std::uint64_t valid = begun > kCapacity ? begun - kCapacity : 0;
+    if (valid > begin)
+      out.erase(out.begin() + static_cast<std::ptrdiff_t>(base),
+                out.begin() + static_cast<std::ptrdiff_t>(
+                                  base + std::min(valid, end) - begin));
+  }
+
+private:
+  static constexpr int kStageShift = 56;
+  static constexpr std::uint64_t kAmountMask =
+      (std::uint64_t{1} << kStageShift) - 1;
+
+  struct Slot {
+    std::atomic<std::uint64_t> startNs{};
+    std::atomic<std::uint64_t> packed{}; ///< Stage over amount
+  };
+
+  std::array<Slot, kCapacity> m_slots{};
+  std::atomic<std::uint64_t> m_begun{};     ///< Pushes started
+  std::atomic<std::uint64_t> m_published{}; ///< Pushes finished
+};
+
+/// Rolling figures for one stage.
+struct StageSummary {
+  std::size_t count{};
+  double p50Ms{};
+  double p99Ms{};
+};
+
+/// Rolling figures over the last few frames.
+struct Summary {
+  std::size_t frames{};
+  std::array<StageSummary, kStageCount> stages{};
+  double evaluationsPerFrame{};
+};
+
+/**
+ * @class Profiler
+ * @brief Owns a ring per thread and reads them all for the overlay and the
+ * trace.
+ *
+ * A thread gets its ring on its first event. Only that first event and
+ * `nameThread()` take the lock; every other push goes straight to the
+ * thread's own ring. A ring outlives its thread, and a new thread given
+ * the same name takes it over, so a worker that is restarted keeps one
+ * line in the trace.
+ */
+class Profiler {
+public:
+  static Profiler &instance() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  /// Nanoseconds since the profiler started.
+  std::uint64_t now() const noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_origin)
+            .count());
+  }
+
+  /// The calling thread's ring.
+  Ring &ring() {
+    Local &local = this->local();
+    if (!local.entry)
+      local.entry = &adopt("thread");
+    return local.entry->ring;
+  }
+
+  void nameThread(std::string_view name) {
+    Local &local = this->local();
+    if (!local.entry) {
+      local.entry = &adopt(name);
+      return;
+    }
+    std::lock_guard lock(m_mutex);
+    local.entry->name = name;
+  }
+
+  /**
+   * @brief Summarizes the last `frames` frames: the median and 99th
+   * percentile of every stage that ran during them, and the evaluations
+   * recorded per frame.
+   */
+  Summary summarize(std::size_t frames) const {
+    std::vector<Event> events{};
+    {
+      std::lock_guard lock(m_mutex);
+      for (const auto &entry : m_entries)
+        entry->ring.snapshot(events);
+    }
+
+    std::vector<std::uint64_t> frameStarts{};
+    for (const Event &event : events)
+      if (event.stage == Stage::Frame)
+        frameStarts.push_back(event.startNs);
+    Summary summary{};
+    if (frameStarts.empty())
+      return summary;
+    summary.frames = std::min(frames, frameStarts.size());
+    std::nth_element(frameStarts.begin(),
+                     frameStarts.end() -
+                         static_cast<std::ptrdiff_t>(summary.frames),
+                     frameStarts.end());
+    const std::uint64_t from =
+        frameStarts[frameStarts.size() - summary.frames];
+
+    std::array<std::vector<std::uint64_t>, kStageCount> durations{};
+    std::uint64_t evaluations = 0;
+    for (const Event &event : events) {
+      if (event.startNs < from)
+        continue;
+      if (event.stage == Stage::Evaluations)
+        evaluations += event.amount;
+      else
+        durations[static_cast<std::size_t>(event.stage)].push_back(
+            event.amount);
+    }
+    for (std::size_t s = 0; s < kStageCount; ++s) {
+      auto &values = durations[s];
+      if (values.empty())
+        continue;
+      std::sort(values.begin(), values.end());
+      auto percentile = [&](double p) {
+        const auto i = static_cast<std::size_t>(
+            p * static_cast<double>(values.size() - 1) + 0.5);
+        return static_cast<double>(values[i]) / 1e6;
+      };
+      summary.stages[s] = {values.size(), percentile(0.5), percentile(0.99)};
+    }
+    summary.evaluationsPerFrame = static_cast<double>(evaluations) /
+                                  static_cast<double>(summary.frames);
+    return summary;
+  }
+
+  /**
+   * @brief Writes every event held as Chrome `trace_event` JSON, for
+   * chrome://tracing or Perfetto.
+   *
+   * Stages become complete ("X") events on their thread's track and counts
+   * become counter ("C") events.
+   *
+   * @return false if the file could not be written.
+   */
+  bool writeChromeTrace(const std::string &path) const {
+    fmt::memory_buffer out{};
+    fmt::format_to(std::back_inserter(out), "{{\"traceEvents\":[");
+    bool first = true;
+    auto separator = [&] {
+      if (!first)
+        out.push_back(',');
+      first = false;
+    };
+    std::vector<Event> events{};
+    std::lock_guard lock(m_mutex);
+    for (std::size_t tid = 0; tid < m_entries.size(); ++tid) {
+      const Entry &entry = *m_entries[tid];
+      separator();
+      fmt::format_to(std::back_inserter(out),
+                     "\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                     tid, entry.name);
+      events.clear();
+      entry.ring.snapshot(events);
+      for (const Event &event : events) {
+        separator();
+        const double ts = static_cast<double>(event.startNs) / 1e3;
+        if (event.stage == Stage::Evaluations)
+          fmt::format_to(std::back_inserter(out),
+                         "\n{{\"name\":\"{}\",\"ph\":\"C\",\"ts\":{:.3f},"
+                         "\"pid\":1,\"tid\":{},\"args\":{{\"{}\":{}}}}}",
+                         name(event.stage), ts, tid, name(event.stage),
+                         event.amount);
+        else
+          fmt::format_to(std::back_inserter(out),
+                         "\n{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},"
+                         "\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+                         name(event.stage), ts,
+                         static_cast<double>(event.amount) / 1e3, tid);
+      }
+    }
+    fmt::format_to(std::back_inserter(out),
+                   "\n],\"displayTimeUnit\":\"ms\"}}\n");
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+      return false;
+    const bool written =
+        std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return std::fclose(file) == 0 && written;
+  }
+
+private:
+  struct Entry {
+    Ring ring{};
+    std::string name{};
+    bool retired{}; ///< Its thread has exited
+  };
+
+  // Hands the entry back when the thread exits.
+  struct Local {
+    Entry *entry{};
+    ~Local() {
+      if (!entry)
+        return;
+      std::lock_guard lock(instance().m_mutex);
+      entry->retired = true;
+    }
+  };
+
+  static Local &local() {
+    thread_local Local local{};
+    return local;
+  }
+
+  Entry &adopt(std::string_view name) {
+    std::lock_guard lock(m_mutex);
+    for (const auto &entry : m_entries) {
+      if (entry->retired && entry->name == name) {
+        entry->retired = false;
+        return *entry;
+      }
+    }
+    m_entries.push_back(std::make_unique<Entry>());
+    m_entries.back()->name = name;
+    return *m_entries.back();
+  }
+
+  std::chrono::steady_clock::time_point m_origin{
+      std::chrono::steady_clock::now()};
+  mutable std::mutex m_mutex{};
+  std::vector<std::unique_ptr<Entry>> m_entries{}; ///< Guarded by m_mutex
+};
+
+/**
+ * @class Scope
+ * @brief Records the time from its construction to its destruction as one
+ * event of the given stage.
+ */
+class Scope {
+public:
+  explicit Scope(Stage stage) noexcept
+      : m_stage(stage), m_startNs(Profiler::instance().now()) {}
+  ~Scope() {
+    Profiler &profiler = Profiler::instance();
+    profiler.ring().push(m_stage, m_startNs, profiler.now() - m_startNs);
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  Stage m_stage;
+  std::uint64_t m_startNs;
+};
+
+inline void count(Stage stage, std::uint64_t amount) {
+  Profiler &profiler = Profiler::instance();
+  profiler.ring().push(stage, profiler.now(), amount);
+}
+
+} // namespace Profiling
@@ -0,0 +1,399 @@
+#pragma once
+#include "../functionParser/ThreadPool.hpp"
+#include "Axes.hpp"
+#include "Curves.hpp"
+#include "Features.hpp"
+#include "Implicit.hpp"
+#include "Parametric.hpp"
+#include "Sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Raster {
+
+/// An 8-bit RGBA colour; alpha blends it over what is already drawn.
+struct Color {
+  std::uint8_t r{};
+  std::uint8_t g{};
+  std::uint8_t b{};
+  std::uint8_t a{255};
+};
+
+/**
+ * @brief An 8-bit RGB image, stored row by row from the top.
+ */
+struct Image {
+  std::size_t width{};
+  std::size_t height{};
+  std::vector<std::uint8_t> pixels{}; ///< Three bytes per pixel
+
+  void resize(std::size_t w, std::size_t h) {
+    width = w;
+    height = h;
+    pixels.resize(3 * w * h);
+  }
+
+  void fill(Color color) {
+    for (std::size_t i = 0; i < pixels.size(); i += 3) {
+      pixels[i] = color.r;
+      pixels[i + 1] = color.g;
+      pixels[i + 2] = color.b;
+    }
+  }
+};
+
+/**
+ * @class Canvas
+ * @brief Anti-aliased lines drawn into an image a band of rows at a time,
+ * the bands in parallel.
+ *
+ * `line()` only records a line. `render()` sorts the lines into bands of
+ * `kBandRows` rows by the rows they cover, and each band then draws its
+ * lines in the order they were added. A band is only ever written by one
+ * thread, so nothing is locked, and the image does not depend on the
+ * number of threads.
+ *
+ * A line covers each pixel by how far the pixel's centre is from it: fully
+ * within half its width, fading out over the next pixel. Coordinates are in
+ * pixels, with the top-left corner of the image at (0, 0).
+ */
+class Canvas {
+public:
+  static constexpr std::size_t kBandRows = 16;
+
+  void clear() { m_lines.clear(); }
+  std::size_t size() const { return m_lines.size(); }
+
+  /**
+   * @brief Adds a line, clipped to an image of the given size.
+   *
+   * Lines with a non-finite end are dropped.
+   */
+  void line(double x0, double y0, double x1, double y1, Color color,
+            std::size_t width, std::size_t height, double thickness = 1) {
+    const double margin = thickness / 2 + 1;
+    if (!clip(x0, y0, x1, y1, -margin, -margin,
+              static_cast<double>(width) + margin,
+              static_cast<double>(height) + margin))
+      return;
+    m_lines.push_back({static_cast<float>(x0), static_cast<float>(y0),
+                       static_cast<float>(x1), static_cast<float>(y1),
+                       static_cast<float>(thickness / 2), color});
+  }
+
+  /// Draws every line into `image`, over what it already holds.
+  void render(Image &image, Tokenizer::ThreadPool *pool = nullptr) {
+    const std::size_t bands = (image.height + kBandRows - 1) / kBandRows;
+    if (bands == 0)
+      return;
+
+    // Counting sort of line indices by band; a line is listed in every band
+    // it reaches.
+    m_bandStart.assign(bands + 1, 0);
+    forEachBand(bands, [&](std::size_t band, std::uint32_t) {
+      ++m_bandStart[band + 1];
+    });
+    for (std::size_t band = 0; band < bands; ++band)
+      m_bandStart[band + 1] += m_bandStart[band];
+    m_bandLines.resize(m_bandStart.back());
+    m_fill.assign(m_bandStart.begin(), m_bandStart.end() - 1);
+    forEachBand(bands, [&](std::size_t band, std::uint32_t index) {
+      m_bandLines[m_fill[band]++] = index;
+    });
+
+    auto drawBands = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t band = begin; band < end; ++band) {
+        const std::size_t top = band * kBandRows;
+        const std::size_t bottom = std::min(top + kBandRows, image.height);
+        for (std::size_t i = m_bandStart[band]; i < m_bandStart[band + 1]; ++i)
+          draw(m_lines[m_bandLines[i]], image, top, bottom);
+      }
+    };
+    if (pool)
+      pool->parallelFor(bands, 1, drawBands);
+    else
+      drawBands(0, bands);
+  }
+
+private:
+  struct Line {
+    float x0{};
+    float y0{};
+    float x1{};
+    float y1{};
+    float halfWidth{};
+    Color color{};
+  };
+
+  // Rows a line can touch, as a half-open range.
+  static void rows(const Line &line, double &first, double &last) {
+    const double reach = line.halfWidth + 1;
+    first = std::floor(std::min(line.y0, line.y1) - reach);
+    last = std::ceil(std::max(line.y0, line.y1) + reach);
+  }
+
+  template <typename Visit>
+  void forEachBand(std::size_t bands, const Visit &visit) const {
+    const auto rowsPerBand = static_cast<double>(kBandRows);
+    for (std::uint32_t index = 0; index < m_lines.size(); ++index) {
+      double first = 0, last = 0;
+      rows(m_lines[index], first, last);
+      const auto from = static_cast<std::size_t>(
+          std::clamp(first / rowsPerBand, 0.0, static_cast<double>(bands)));
+      const auto to = static_cast<std::size_t>(std::clamp(
+          std::ceil(last / rowsPerBand), 0.0, static_cast<double>(bands)));
+      for (std::size_t band = from; band < to; ++band)
+        visit(band, index);
+    }
+  }
+
+  // Draws the part of `line` that falls in rows [top, bottom).
+  static void draw(const Line &line, Image &image, std::size_t top,
+                   std::size_t bottom) {
+    const double x0 = line.x0, y0 = line.y0;
+    const double dx = line.x1 - x0, dy = line.y1 - y0;
+    const double lengthSquared = dx * dx + dy * dy;
+    const double reach = line.halfWidth + 1;
+    const double alpha = line.color.a / 255.0;
+
+    double first = 0, last = 0;
+    rows(line, first, last);
+    const auto rowBegin = static_cast<std::size_t>(
+        std::max(first, static_cast<double>(top)));
+    const auto rowEnd = static_cast<std::size_t>(
+        std::min(last, static_cast<double>(bottom)));
+    for (std::size_t row = rowBegin; row < rowEnd; ++row) {
+      // Columns of the stretch of the line within reach of this row.
+      double t0 = 0, t1 = 1;
+      if (dy != 0) {
+        t0 = (static_cast<double>(row) - reach - y0) / dy;
+        t1 = (static_cast<double>(row) + 1 + reach - y0) / dy;
+        if (t0 > t1)
+          std::swap(t0, t1);
+        t0 = std::max(t0, 0.0);
+        t1 = std::min(t1, 1.0);
+        if (t0 > t1)
+          continue;
+      }
+      const double xa = x0 + t0 * dx, xb = x0 + t1 * dx;
+      const double colFirst =
+          std::max(std::floor(std::min(xa, xb) - reach), 0.0);
+      const double colLast = std::min(std::ceil(std::max(xa, xb) + reach),
+                                      static_cast<double>(image.width));
+      const double cy = static_cast<double>(row) + 0.5;
+      std::uint8_t *pixel =
+          image.pixels.data() + 3 * (row * image.width +
+                                     static_cast<std::size_t>(colFirst));
+      for (double col = colFirst; col < colLast; ++col, pixel += 3) {
+        const double cx = col + 0.5;
+        double t = lengthSquared > 0
+                       ? ((cx - x0) * dx + (cy - y0) * dy) / lengthSquared
+                       : 0;
+        t = std::clamp(t, 0.0, 1.0);
+        const double distance = std::hypot(cx - (x0 + t * dx),
+                                           cy - (y0 + t * dy));
+        const double coverage =
+            std::clamp(line.halfWidth + 0.5 - distance, 0.0, 1.0) * alpha;
+        if (coverage <= 0)
+          continue;
+        pixel[0] = blend(pixel[0], line.color.r, coverage);
+        pixel[1] = blend(pixel[1], line.color.g, coverage);
+        pixel[2] = blend(pixel[2], line.color.b, coverage);
+      }
+    }
+  }
+
+  static std::uint8_t blend(std::uint8_t under, std::uint8_t over,
+                            double coverage) {
+    return static_cast<std::uint8_t>(
+        std::lround(under + (over - under) * coverage));
+  }
+
+  // Liang-Barsky; false if nothing of the line is left.
+  static bool clip(double &x0, double &y0, double &x1, double &y1, double xMin,
+                   double yMin, double xMax, double yMax) {
+    if (!std::isfinite(x0) || !std::isfinite(y0) || !std::isfinite(x1) ||
+        !std::isfinite(y1))
+      return false;
+    const double dx = x1 - x0, dy = y1 - y0;
+    double t0 = 0, t1 = 1;
+    auto edge = [&](double p, double q) {
+      if (p == 0)
+        return q >= 0;
+      const double t = q / p;
+      if (p < 0)
+        t0 = std::max(t0, t);
+      else
+        t1 = std::min(t1, t);
+      return t0 <= t1;
+    };
+    if (!edge(-dx, x0 - xMin) || !edge(dx, xMax - x0) ||
+        !edge(-dy, y0 - yMin) || !edge(dy, yMax - y0))
+      return false;
+    const double ax = x0, ay = y0;
+    x0 = ax + t0 * dx;
+    y0 = ay + t0 * dy;
+    x1 = ax + t1 * dx;
+    y1 = ay + t1 * dy;
+    return true;
+  }
+
+  std::vector<Line> m_lines{};
+  std::vector<std::size_t> m_bandStart{}; ///< First entry of every band
+  std::vector<std::uint32_t> m_bandLines{};
+  std::vector<std::size_t> m_fill{};
+};
+
+/**
+ * @brief What to draw and how, as the grapher window would show it.
+ */
+struct PlotSettings {
+  std::size_t width{1200};
+  std::size_t height{900};
+  double xMin{-15};
+  double xMax{15};
+  double yMin{-11.25};
+  double yMax{11.25};
+  bool adaptive{}; ///< Sample y = f(x) adaptively, as F2 does
+  Sampling::AdaptiveSettings adaptiveSettings{};
+  bool features{}; ///< Mark zeros, extrema and intersections, as F3 does
+};
+
+/// Half the width of a feature marker, as `GraphSet` draws it.
+inline constexpr double kMarkerPx = 4;
+
+/**
+ * @brief Samples the curves and adds the picture of them to `canvas`, in
+ * the order the window draws it: grid, axes and ticks, then the y = f(x)
+ * curves, the other curves and the feature markers.
+ *
+ * y = f(x) curves are sampled once per pixel column, or adaptively.
+ *
+ * @return The number of evaluations.
+ */
+inline std::size_t drawPlot(const Sampling::CurveList &list,
+                            const PlotSettings &settings, Canvas &canvas,
+                            Tokenizer::ThreadPool *pool = nullptr) {
+  const std::size_t width = settings.width, height = settings.height;
+  Sampling::Viewport view{};
+  view.xMin = settings.xMin;
+  view.xMax = settings.xMax;
+  view.yMin = settings.yMin;
+  view.yMax = settings.yMax;
+  view.pixelsPerUnitX = static_cast<double>(width) / (view.xMax - view.xMin);
+  view.pixelsPerUnitY = static_cast<double>(height) / (view.yMax - view.yMin);
+
+  // The window draws in float and drops what does not fit in one.
+  auto line = [&](Sampling::Point a, Sampling::Point b, Color color) {
+    if (!std::isfinite(static_cast<float>(a.y)) ||
+        !std::isfinite(static_cast<float>(b.y)))
+      return;
+    canvas.line((a.x - view.xMin) * view.pixelsPerUnitX,
+                (view.yMax - a.y) * view.pixelsPerUnitY,
+                (b.x - view.xMin) * view.pixelsPerUnitX,
+                (view.yMax - b.y) * view.pixelsPerUnitY, color, width, height);
+  };
+
+  // The window lays the grid out in its own coordinates, where y grows
+  // downwards.
+  const auto left = static_cast<float>(view.xMin);
+  const auto right = static_cast<float>(view.xMax);
+  const auto topY = -static_cast<float>(view.yMax);
+  const auto bottomY = -static_cast<float>(view.yMin);
+  const AxisLayout axes = layoutAxes(left, right, topY, bottomY);
+  const Color gridColor{200, 200, 200, 100};
+  const Color black{0, 0, 0};
+  const double tickX = kAxisTickPx / view.pixelsPerUnitX;
+  const double tickY = kAxisTickPx / view.pixelsPerUnitY;
+  for (const float x : axes.xs)
+    line({x, -topY}, {x, -bottomY}, gridColor);
+  for (const float y : axes.ys)
+    line({left, -y}, {right, -y}, gridColor);
+  line({view.xMin, 0}, {view.xMax, 0}, black);
+  line({0, view.yMin}, {0, view.yMax}, black);
+  for (const float x : axes.xs)
+    line({x, tickY}, {x, -tickY}, black);
+  for (const float y : axes.ys)
+    line({-tickX, -y}, {tickX, -y}, black);
+
+  std::vector<Tokenizer::CompiledExpression> functions{};
+  std::vector<Color> functionColors{};
+  for (std::size_t i = 0; i < list.curves.size(); ++i) {
+    if (list.curves[i].kind != Sampling::Curve::Kind::Function)
+      continue;
+    const Sampling::Rgb rgb = Sampling::curveColor(i);
+    functions.push_back(list.curves[i].expressions[0]);
+    functionColors.push_back({rgb.r, rgb.g, rgb.b});
+  }
+
+  std::size_t evaluations = 0;
+  std::vector<Sampling::Point> points{};
+  auto polyline = [&](Color color) {
+    for (std::size_t i = 0; i + 1 < points.size(); ++i)
+      line(points[i], points[i + 1], color);
+    points.clear();
+  };
+  if (settings.adaptive) {
+    for (std::size_t c = 0; c < functions.size(); ++c) {
+      evaluations += Sampling::sampleAdaptive(
+          functions[c], view, settings.adaptiveSettings, points);
+      polyline(functionColors[c]);
+    }
+  } else if (!functions.empty()) {
+    evaluations +=
+        Sampling::sampleUniform(functions, view, width, points, pool);
+    const std::size_t perCurve = points.size() / functions.size();
+    for (std::size_t c = 0; c < functions.size(); ++c)
+      for (std::size_t i = c * perCurve; i + 1 < (c + 1) * perCurve; ++i)
+        line(points[i], points[i + 1], functionColors[c]);
+    points.clear();
+  }
+
+  std::vector<Sampling::Segment> segments{};
+  for (std::size_t i = 0; i < list.curves.size(); ++i) {
+    const Sampling::Curve &curve = list.curves[i];
+    const Sampling::Rgb rgb = Sampling::curveColor(i);
+    const Color color{rgb.r, rgb.g, rgb.b};
+    switch (curve.kind) {
+    case Sampling::Curve::Kind::Function:
+      break;
+    case Sampling::Curve::Kind::Implicit:
+      segments.clear();
+      evaluations += Sampling::contourImplicit(curve.expressions[0], view, {},
+                                               segments, pool);
+      for (const auto &segment : segments)
+        line(segment.a, segment.b, color);
+      break;
+    case Sampling::Curve::Kind::Parametric:
+      evaluations += Sampling::sampleParametric(
+          curve.expressions[0], curve.expressions[1], view, {}, points);
+      polyline(color);
+      break;
+    case Sampling::Curve::Kind::Polar:
+      evaluations +=
+          Sampling::samplePolar(curve.expressions[0], view, {}, points);
+      polyline(color);
+      break;
+    }
+  }
+
+  if (settings.features && !functions.empty()) {
+    std::vector<Sampling::Feature> features{};
+    evaluations += Sampling::findFeatures(functions, view, features, pool);
+    const double dx = kMarkerPx / view.pixelsPerUnitX;
+    const double dy = kMarkerPx / view.pixelsPerUnitY;
+    for (const auto &feature : features) {
+      const Sampling::Point at = feature.at;
+      const Color color = functionColors[feature.curve];
+      line({at.x - dx, at.y - dy}, {at.x + dx, at.y + dy}, color);
+      line({at.x - dx, at.y + dy}, {at.x + dx, at.y - dy}, color);
+    }
+  }
+  return evaluations;
+}
+
+} // namespace Raster
@@ -0,0 +1,369 @@
+#pragma once
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace Sampling {
+
+/**
+ * @brief A sampled point of a curve. A non-finite `y` breaks the polyline.
+ */
+struct Point {
+  double x{};
+  double y{};
+};
+
+/**
+ * @brief The visible region and its pixel density.
+ */
+struct Viewport {
+  double xMin{};
+  double xMax{};
+  double yMin{};
+  double yMax{};
+  double pixelsPerUnitX{1};
+  double pixelsPerUnitY{1};
+
+  bool operator==(const Viewport &other) const = default;
+};
+
+/**
+ * @brief Limits for adaptive sampling.
+ */
+struct AdaptiveSettings {
+  double tolerancePx{0.5};          ///< Allowed deviation from a chord
+  int maxDepth{12};                 ///< Subdivisions of one starting interval
+  std::size_t maxEvaluations{8192}; ///< Evaluation budget per sweep
+  double initialSpacingPx{4};       ///< Width of the starting intervals
+
+  bool operator==(const AdaptiveSettings &other) const = default;
+};
+
+namespace detail {
+
+/// Segments steeper than this many pixels are checked for a pole.
+inline constexpr double kPoleCheckPx = 32;
+/// Halvings spent looking for the pole in such a segment.
+inline constexpr int kPoleDepth = 8;
+
+/// Whether the expression may be unbounded somewhere in [lo, hi].
+inline bool hasPole(const Tokenizer::CompiledExpression &expr, double lo,
+                    double hi, int depth = kPoleDepth) {
+  // Interval bounds overestimate, so an unbounded range is only believed
+  // once it survives every halving on the way down.
+  if (expr.evalInterval({lo, hi}).isBounded())
+    return false;
+  if (depth == 0)
+    return true;
+  const double mid = 0.5 * (lo + hi);
+  return hasPole(expr, lo, mid, depth - 1) || hasPole(expr, mid, hi, depth - 1);
+}
+
+/// Whether the segment is tall enough on screen to be checked for a pole.
+inline bool isSteep(const Point &a, const Point &b, const Viewport &view) {
+  return std::isfinite(a.y) && std::isfinite(b.y) &&
+         std::abs(b.y - a.y) * view.pixelsPerUnitY > kPoleCheckPx;
+}
+
+/// Whether f provably has no finite value inside the view's y-range.
+inline bool isHidden(const Tokenizer::Interval &range, const Viewport &view) {
+  return range.isEmpty() || range.lo > view.yMax || range.hi < view.yMin;
+}
+
+} // namespace detail
+
+/**
+ * @brief Samples `count` equal intervals across the viewport for every
+ * expression, appending the curves to `out` one after the other.
+ *
+ * All expressions share one grid: every block of
+ * `CompiledExpression::kBatchSize` x-values is computed once and run through
+ * each expression while it is still in cache. With a pool, the blocks are
+ * evaluated in parallel, each straight into its own stretch of the output.
+ *
+ * Each block is first bounded in interval arithmetic. If the bound lies
+ * outside the view's y-range only the block's ends are evaluated and the
+ * points between them are left non-finite, and a steep segment whose bound
+ * stays unbounded however far it is halved is broken at the pole.
+ *
+ * @return The number of evaluations.
+ */
+inline std::size_t
+sampleUniform(std::span<const Tokenizer::CompiledExpression> exprs,
+              const Viewport &view, std::size_t count, std::vector<Point> &out,
+              Tokenizer::ThreadPool *pool = nullptr) {
+  static_assert(Tokenizer::CompiledExpression::kBatchSize %
+                        Tokenizer::ThreadPool::kCacheLineDoubles ==
+                    0,
+                "Blocks should not share cache lines");
+
+  const std::size_t base = out.size();
+  const std::size_t points = count + 1;
+  const double step = (view.xMax - view.xMin) / static_cast<double>(count);
+  out.resize(base + exprs.size() * points);
+
+  std::atomic<std::size_t> evaluations{0};
+  auto sampleRange = [&](std::size_t begin, std::size_t end) {
+    double xs[Tokenizer::CompiledExpression::kBatchSize];
+    double ys[Tokenizer::CompiledExpression::kBatchSize];
+    std::size_t spent = 0;
+    for (; begin < end; begin += std::size(xs)) {
+      const std::size_t n = std::min(std::size(xs), end - begin);
+      for (std::size_t i = 0; i < n; ++i)
+        xs[i] = view.xMin + static_cast<double>(begin + i) * step;
+      for (std::size_t e = 0; e < exprs.size(); ++e) {
+        const auto range = exprs[e].evalInterval({xs[0], xs[n - 1]});
+        if (!detail::isHidden(range, view)) {
+          exprs[e].evalBatch({xs, n}, {ys, n});
+          spent += n;
+        } else {
+          // Only the ends are needed, for the segments that join the
+          // neighbouring blocks; everything between is off screen.
+          std::fill(ys, ys + n, std::numeric_limits<double>::quiet_NaN());
+          if (!range.isEmpty()) {
+            ys[0] = exprs[e].eval(xs[0]);
+            ys[n - 1] = exprs[e].eval(xs[n - 1]);
+            spent += std::min<std::size_t>(n, 2);
+          }
+        }
+        Point *curve = out.data() + base + e * points + begin;
+        for (std::size_t i = 0; i < n; ++i)
+          curve[i] = {xs[i], ys[i]};
+      }
+    }
+    evaluations.fetch_add(spent, std::memory_order_relaxed);
+  };
+  if (pool)
+    pool->parallelFor(points, Tokenizer::CompiledExpression::kBatchSize,
+                      sampleRange);
+  else
+    sampleRange(0, points);
+
+  // A segment across a pole would be drawn as a vertical line. The far end
+  // of it is dropped instead, which also drops the next segment, but that
+  // one is steep and almost entirely off screen.
+  for (std::size_t e = 0; e < exprs.size(); ++e) {
+    Point *curve = out.data() + base + e * points;
+    for (std::size_t i = 0; i + 1 < points; ++i) {
+      Point &a = curve[i];
+      Point &b = curve[i + 1];
+      if (detail::isSteep(a, b, view) && detail::hasPole(exprs[e], a.x, b.x))
+        (std::abs(a.y) > std::abs(b.y) ? a : b).y =
+            std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+  return evaluations;
+}
+
+/**
+ * @brief Samples `count` equal intervals across the viewport.
+ * @return The number of evaluations.
+ */
+inline std::size_t sampleUniform(const Tokenizer::CompiledExpression &expr,
+                                 const Viewport &view, std::size_t count,
+                                 std::vector<Point> &out,
+                                 Tokenizer::ThreadPool *pool = nullptr) {
+  return sampleUniform(std::span(&expr, 1), view, count, out, pool);
+}
+
+namespace detail {
+
+class AdaptiveSampler {
+public:
+  AdaptiveSampler(const Tokenizer::CompiledExpression &expr,
+                  const Viewport &view, const AdaptiveSettings &settings,
+                  std::vector<Point> &out)
+      : m_expr(expr), m_view(view), m_settings(settings), m_out(out) {}
+
+  std::size_t run() {
+    // Features narrower than the starting grid can fall between its points
+    // and every midpoint, so the grid is tied to the pixel width rather than
+    // to a fixed count.
+    const double widthPx =
+        (m_view.xMax - m_view.xMin) * m_view.pixelsPerUnitX;
+    const auto intervals = static_cast<std::size_t>(std::clamp(
+        std::ceil(widthPx / m_settings.initialSpacingPx), 1.0, 65536.0));
+
+    const double step =
+        (m_view.xMax - m_view.xMin) / static_cast<double>(intervals);
+
+    // The grid is evaluated a block at a time, with slopes. A block the
+    // curve provably stays above or below is a single invisible segment, so
+    // only its end is evaluated and nothing in it is refined.
+    double xs[Tokenizer::CompiledExpression::kBatchSize];
+    double ys[Tokenizer::CompiledExpression::kBatchSize];
+    double slopes[Tokenizer::CompiledExpression::kBatchSize];
+    Knot last = at(m_view.xMin);
+    m_evaluations = 1;
+    m_out.push_back(last.p);
+    for (std::size_t begin = 1; begin <= intervals; begin += std::size(xs)) {
+      const std::size_t n = std::min(std::size(xs), intervals + 1 - begin);
+      for (std::size_t i = 0; i < n; ++i)
+        xs[i] = m_view.xMin + static_cast<double>(begin + i) * step;
+      if (isHidden(m_expr.evalInterval({last.p.x, xs[n - 1]}), m_view)) {
+        last = at(xs[n - 1]);
+        ++m_evaluations;
+        m_out.push_back(last.p);
+        continue;
+      }
+      m_expr.evalDualBatch({xs, n}, {ys, n}, {slopes, n});
+      m_evaluations += n;
+      for (std::size_t i = 0; i < n; ++i) {
+        const Knot next{{xs[i], ys[i]}, slopes[i]};
+        subdivide(last, next, 0);
+        last = next;
+      }
+    }
+    return m_evaluations;
+  }
+
+private:
+  // A sample together with the slope of f there.
+  struct Knot {
+    Point p{};
+    double slope{};
+  };
+
+  Knot at(double x) const {
+    const auto [y, slope] = m_expr.evalDual(x);
+    return {{x, y}, slope};
+  }
+
+  // Bound in pixels on how far the cubic through `a` and `b` with their
+  // slopes strays vertically from the chord, which is never less than its
+  // distance to it. Infinite where a value or slope is not finite.
+  double hermiteError(const Knot &a, const Knot &b) const {
+    const double h = b.p.x - a.p.x;
+    const double chord = (b.p.y - a.p.y) / h;
+    // The cubic minus the chord is h t (1 - t) ((1 - t) ea - t eb), with
+    // ea, eb the slopes less the chord's; t (1 - t)^2 peaks at 4/27.
+    const double bound = h * 4.0 / 27.0 *
+                         (std::abs(a.slope - chord) + std::abs(b.slope - chord)) *
+                         m_view.pixelsPerUnitY;
+    return std::isfinite(bound) ? bound
+                                : std::numeric_limits<double>::infinity();
+  }
+
+  // Distance in pixels from `m` to the chord through `a` and `b`.
+  double chordError(const Point &a, const Point &m, const Point &b) const {
+    const double ax = a.x * m_view.pixelsPerUnitX;
+    const double ay = a.y * m_view.pixelsPerUnitY;
+    const double dx = b.x * m_view.pixelsPerUnitX - ax;
+    const double dy = b.y * m_view.pixelsPerUnitY - ay;
+    const double mx = m.x * m_view.pixelsPerUnitX - ax;
+    const double my = m.y * m_view.pixelsPerUnitY - ay;
+    const double length = std::hypot(dx, dy);
+    if (length == 0)
+      return std::hypot(mx, my);
+    return std::abs(dx * my - dy * mx) / length;
+  }
+
+  // Whether both ends lie beyond the same edge of the view and f provably
+  // stays there in between.
+  bool isOffScreen(const Point &a, const Point &b) const {
+    const bool above = a.y > m_view.yMax && b.y > m_view.yMax;
+    const bool below = a.y < m_view.yMin && b.y < m_view.yMin;
+    return (above || below) &&
+           isHidden(m_expr.evalInterval({a.x, b.x}), m_view);
+  }
+
+  // Emits `b`, breaking the curve first if a pole lies between it and `a`.
+  // Such a segment can be left by running out of refinement, or pass the
+  // chord test because it is nearly vertical.
+  void emit(const Point &a, const Point &b) {
+    if (isSteep(a, b, m_view) && hasPole(m_expr, a.x, b.x))
+      m_out.push_back(
+          {0.5 * (a.x + b.x), std::numeric_limits<double>::quiet_NaN()});
+    m_out.push_back(b);
+  }
+
+  // Emits the points after `a` up to and including `b`.
+  void subdivide(const Knot &a, const Knot &b, int depth) {
+    if (depth >= m_settings.maxDepth ||
+        m_evaluations >= m_settings.maxEvaluations) {
+      emit(a.p, b.p);
+      return;
+    }
+
+    // Where the slopes at both ends already pin the curve to the chord the
+    // midpoint is not needed.
+    if (hermiteError(a, b) <= m_settings.tolerancePx) {
+      emit(a.p, b.p);
+      return;
+    }
+
+    const Knot m = at(0.5 * (a.p.x + b.p.x));
+    ++m_evaluations;
+
+    const bool finiteA = std::isfinite(a.p.y);
+    const bool finiteB = std::isfinite(b.p.y);
+    const bool finiteM = std::isfinite(m.p.y);
+    if (!finiteA && !finiteB && !finiteM) {
+      m_out.push_back(b.p);
+      return;
+    }
+
+    // Where the curve enters or leaves its domain, keep refining so the
+    // visible part reaches the boundary; otherwise stop once the chord is
+    // within tolerance.
+    if (finiteA && finiteB && finiteM &&
+        chordError(a.p, m.p, b.p) <= m_settings.tolerancePx) {
+      emit(a.p, m.p);
+      emit(m.p, b.p);
+      return;
+    }
+
+    // Off screen there is nothing to refine for.
+    if (isOffScreen(a.p, b.p)) {
+      m_out.push_back(b.p);
+      return;
+    }
+
+    subdivide(a, m, depth + 1);
+    subdivide(m, b, depth + 1);
+  }
+
+  const Tokenizer::CompiledExpression &m_expr;
+  const Viewport &m_view;
+  const AdaptiveSettings &m_settings;
+  std::vector<Point> &m_out;
+  std::size_t m_evaluations{};
+};
+
+} // namespace detail
+
+/**
+ * @brief Samples the viewport by recursive subdivision.
+ *
+ * Starts from a uniform grid of `initialSpacingPx` wide intervals and halves
+ * every interval whose midpoint lies more than `tolerancePx` pixels off the
+ * chord between its endpoints, so straight stretches cost one evaluation per
+ * interval while steep or oscillating parts are refined. Every point is
+ * evaluated together with its slope, and an interval whose end slopes bound
+ * the curve to within `tolerancePx` of the chord is accepted without
+ * evaluating its midpoint at all. Subdivision stops at `maxDepth` or once
+ * `maxEvaluations` is spent.
+ *
+ * Stretches that interval arithmetic proves to lie above or below the view
+ * are not refined, and starting blocks of `kBatchSize` intervals that lie
+ * there entirely are skipped. A pole left between two points at the end of
+ * refinement breaks the curve.
+ *
+ * @return The number of evaluations.
+ */
+inline std::size_t sampleAdaptive(const Tokenizer::CompiledExpression &expr,
+                                  const Viewport &view,
+                                  const AdaptiveSettings &settings,
+                                  std::vector<Point> &out) {
+  return detail::AdaptiveSampler(expr, view, settings, out).run();
+}
+
+} // namespace Sampling
@@ -0,0 +1,278 @@
+#pragma once
+#include "../functionParser/ThreadPool.hpp"
+#include "Sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <span>
+#include <stop_token>
+#include <unordered_map>
+#include <vector>
+
+namespace Sampling {
+
+/**
+ * @brief Identifies the x-range [index, index + 1) * 2^level.
+ */
+struct TileKey {
+  std::int64_t index{};
+  int level{};
+
+  bool operator==(const TileKey &other) const noexcept = default;
+};
+
+struct TileKeyHash {
+  std::size_t operator()(const TileKey &key) const noexcept {
+    std::size_t h = std::hash<std::int64_t>{}(key.index);
+    h ^= static_cast<std::size_t>(key.level) + 0x9e3779b97f4a7c15ULL +
+         (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+/**
+ * @brief The samples of every curve over one tile.
+ */
+struct Tile {
+  std::vector<Point> points{};     ///< Every curve's points, back to back
+  std::vector<std::size_t> ends{}; ///< End of each curve in `points`
+
+  /// Closes the curve whose points were appended since the last one.
+  void endCurve() { ends.push_back(points.size()); }
+
+  std::size_t curveCount() const { return ends.size(); }
+  std::span<const Point> curve(std::size_t i) const {
+    const std::size_t begin = i == 0 ? 0 : ends[i - 1];
+    return std::span<const Point>(points).subspan(begin, ends[i] - begin);
+  }
+};
+
+/**
+ * @class TileCache
+ * @brief Sampled x-tiles kept across frames in a power-of-two pyramid.
+ *
+ * A tile on level `L` spans 2^L world units, and the level is chosen so a
+ * tile is between half and all of `tileWidthPx` pixels wide on screen.
+ * Panning therefore only samples the tiles that scroll into view, and a zoom
+ * only invalidates anything once it crosses a power of two.
+ *
+ * Tiles missing after a zoom are drawn from the next coarser tile, or from
+ * both finer tiles, while at most `maxTilesPerFrame` of them are sampled per
+ * frame; a tile with no stand-in is always sampled. Least recently used
+ * tiles are dropped once the cache holds more than `byteBudget` bytes, but
+ * never the ones returned by the current `collect()`.
+ *
+ * Samplers may leave out what lies above or below the view, so tiles are
+ * sampled for the view's y-range widened by `yMargin` view heights on
+ * either side, and sampled again once the view leaves that band.
+ */
+class TileCache {
+public:
+  struct Settings {
+    double tileWidthPx{384};          ///< Widest a tile gets on screen
+    std::size_t byteBudget{16 << 20}; ///< Memory the samples may use
+    std::size_t maxTilesPerFrame{8};  ///< Tiles sampled while stand-ins show
+    double yMargin{1};                ///< View heights sampled beyond the view
+  };
+
+  /**
+   * @brief Samples one tile.
+   *
+   * Gets the tile's x-range, the y-range it has to be right in and its
+   * pixel density at the tile's level, fills in the tile and returns the
+   * evaluations spent.
+   */
+  using Sampler = std::function<std::size_t(const Viewport &, Tile &)>;
+
+  Settings &settings() { return m_settings; }
+
+  /// Drops every tile, e.g. after the expression or sampling changed.
+  void clear() {
+    m_tiles.clear();
+    m_lru.clear();
+    m_bytes = 0;
+  }
+
+  /// Bytes currently held by cached samples.
+  std::size_t bytes() const { return m_bytes; }
+  std::size_t size() const { return m_tiles.size(); }
+
+  /// The level whose tiles are at most `tileWidthPx` pixels wide.
+  int levelFor(double pixelsPerUnit) const {
+    const double level =
+        std::floor(std::log2(m_settings.tileWidthPx / pixelsPerUnit));
+    return static_cast<int>(std::clamp(level, -900.0, 900.0));
+  }
+
+  /**
+   * @brief Gets the tiles covering the view, sampling the ones missing.
+   *
+   * @param view The visible region.
+   * @param sample Called for every tile that has to be sampled; with a
+   * pool, from several threads at once.
+   * @param out Receives every tile to draw, in x order. The pointers stay
+   * valid until the next call to `collect()` or `clear()`.
+   * @param pool Threads to sample missing tiles on, if any.
+   * @param stop Once requested, no further tiles are sampled. Tiles already
+   * sampled are still cached, but `out` then holds null for the rest.
+   * @return The number of evaluations spent.
+   */
+  std::size_t collect(const Viewport &view, const Sampler &sample,
+                      std::vector<const Tile *> &out,
+                      Tokenizer::ThreadPool *pool = nullptr,
+                      const std::stop_token &stop = {}) {
+    out.clear();
+    ++m_frame;
+
+    const int level = levelFor(view.pixelsPerUnitX);
+    const double width = std::ldexp(1.0, level);
+    const auto first = static_cast<std::int64_t>(std::floor(view.xMin / width));
+    const auto last = static_cast<std::int64_t>(std::floor(view.xMax / width));
+    const double margin = m_settings.yMargin * (view.yMax - view.yMin);
+
+    std::vector<Pending> pending{};
+    const Entry *lastStandIn = nullptr;
+    for (std::int64_t index = first; index <= last; ++index) {
+      const TileKey key{index, level};
+      if (const Entry *entry = find(key, view)) {
+        out.push_back(&entry->tile);
+        continue;
+      }
+
+      if (pending.size() >= m_settings.maxTilesPerFrame) {
+        const Entry *parent = find({floorHalf(index), level + 1}, view);
+        if (parent) {
+          if (parent != lastStandIn)
+            out.push_back(&parent->tile);
+          lastStandIn = parent;
+          continue;
+        }
+        const Entry *left = find({2 * index, level - 1}, view);
+        const Entry *right = find({2 * index + 1, level - 1}, view);
+        if (left && right) {
+          out.push_back(&left->tile);
+          out.push_back(&right->tile);
+          continue;
+        }
+      }
+
+      Pending &tile = pending.emplace_back();
+      tile.key = key;
+      tile.slot = out.size();
+      tile.view = view;
+      tile.view.xMin = static_cast<double>(index) * width;
+      tile.view.xMax = static_cast<double>(index + 1) * width;
+      tile.view.yMin = view.yMin - margin;
+      tile.view.yMax = view.yMax + margin;
+      tile.view.pixelsPerUnitX = m_settings.tileWidthPx / width;
+      tile.view.pixelsPerUnitY = tile.view.pixelsPerUnitX *
+                                 (view.pixelsPerUnitY / view.pixelsPerUnitX);
+      out.push_back(nullptr);
+    }
+
+    // Tiles are independent, so each one is sampled on whichever thread
+    // takes it and only the bookkeeping below is serial.
+    auto sampleRange = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end && !stop.stop_requested(); ++i) {
+        pending[i].evaluations = sample(pending[i].view, pending[i].tile);
+        pending[i].sampled = true;
+      }
+    };
+    if (pool)
+      pool->parallelFor(pending.size(), 1, sampleRange);
+    else
+      sampleRange(0, pending.size());
+
+    std::size_t evaluations = 0;
+    for (auto &tile : pending) {
+      if (!tile.sampled)
+        continue;
+      evaluations += tile.evaluations;
+      out[tile.slot] = &insert(tile.key, tile.view, std::move(tile.tile)).tile;
+    }
+
+    evict();
+    return evaluations;
+  }
+
+private:
+  struct Pending {
+    TileKey key{};
+    std::size_t slot{}; ///< Index of the tile in collect()'s output
+    Viewport view{};
+    Tile tile{};
+    std::size_t evaluations{};
+    bool sampled{};
+  };
+
+  struct Entry {
+    Tile tile{};
+    double yMin{}; ///< y-range the tile was sampled for
+    double yMax{};
+    std::list<TileKey>::iterator lru{};
+    std::uint64_t frame{}; ///< Last collect() that used the tile
+  };
+
+  static std::int64_t floorHalf(std::int64_t index) {
+    return index >= 0 ? index / 2 : -((-index + 1) / 2);
+  }
+
+  static std::size_t footprint(const Entry &entry) {
+    return sizeof(Entry) + sizeof(TileKey) +
+           entry.tile.points.capacity() * sizeof(Point) +
+           entry.tile.ends.capacity() * sizeof(std::size_t);
+  }
+
+  // Looks up a tile that is good for the view and marks it as used by this
+  // frame.
+  const Entry *find(const TileKey &key, const Viewport &view) {
+    auto it = m_tiles.find(key);
+    if (it == m_tiles.end() || view.yMin < it->second.yMin ||
+        view.yMax > it->second.yMax)
+      return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    it->second.frame = m_frame;
+    return &it->second;
+  }
+
+  // Adds a tile, replacing one sampled for a y-range the view has left.
+  const Entry &insert(const TileKey &key, const Viewport &view, Tile tile) {
+    tile.points.shrink_to_fit();
+    if (auto it = m_tiles.find(key); it != m_tiles.end()) {
+      m_bytes -= footprint(it->second);
+      m_lru.erase(it->second.lru);
+    }
+    m_lru.push_front(key);
+    Entry &entry = m_tiles[key];
+    entry.tile = std::move(tile);
+    entry.yMin = view.yMin;
+    entry.yMax = view.yMax;
+    entry.lru = m_lru.begin();
+    entry.frame = m_frame;
+    m_bytes += footprint(entry);
+    return entry;
+  }
+
+  void evict() {
+    while (m_bytes > m_settings.byteBudget && !m_lru.empty()) {
+      auto it = m_tiles.find(m_lru.back());
+      if (it->second.frame == m_frame)
+        break; // so is everything else: it is all on screen
+      m_bytes -= footprint(it->second);
+      m_tiles.erase(it);
+      m_lru.pop_back();
+    }
+  }
+
+  Settings m_settings{};
+  std::unordered_map<TileKey, Entry, TileKeyHash> m_tiles{};
+  std::list<TileKey> m_lru{}; ///< Most recently used first
+  std::size_t m_bytes{};
+  std::uint64_t m_frame{};
+};
+
+} // namespace Sampling
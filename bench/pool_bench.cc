@@ -0,0 +1,108 @@
+// Measures how curve sampling scales with the size of the thread pool:
+//   sweep  - one uniform sweep, split into blocks across the pool
+//   tiles  - a cold tile cache filled with adaptively sampled tiles
+//
+// Every run is compared with the single-threaded one; any difference in the
+// sampled points makes the benchmark exit non-zero.
+//
+// Usage: fncxx_pool_bench [max threads] [samples]
+#include "../Grapher/Sampling.hpp"
+#include "../Grapher/TileCache.hpp"
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+bool samePoints(const std::vector<Sampling::Point> &a,
+                const std::vector<Sampling::Point> &b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+}
+
+// Best of a few runs, to keep scheduler noise out of the speedups.
+template <class Fn> double bestOf(int runs, Fn &&fn) {
+  double best = 1e300;
+  for (int i = 0; i < runs; ++i) {
+    auto start = Clock::now();
+    fn();
+    best = std::min(best, millisecondsSince(start));
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::size_t maxThreads =
+      (argc > 1) ? std::stoul(argv[1])
+                 : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t samples = (argc > 2) ? std::stoul(argv[2]) : 1 << 20;
+
+  const Tokenizer::CompiledExpression expr("sin(x)*exp(cos(x)/3)+sqrt(x^2+1)");
+  const Sampling::Viewport view{-500, 500, -10, 10, 64, 64};
+
+  std::vector<Sampling::Point> sweepReference{}, tilesReference{};
+  double sweepBase = 0, tilesBase = 0;
+  int mismatches = 0;
+
+  fmt::print("{:>8} {:>12} {:>9} {:>12} {:>9}\n", "threads", "sweep ms",
+             "speedup", "tiles ms", "speedup");
+  for (std::size_t threads = 1; threads <= maxThreads; ++threads) {
+    Tokenizer::ThreadPool pool(threads);
+
+    std::vector<Sampling::Point> sweep{};
+    const double sweepMs = bestOf(5, [&] {
+      sweep.clear();
+      Sampling::sampleUniform(expr, view, samples, sweep, &pool);
+    });
+
+    std::vector<Sampling::Point> tiles{};
+    const double tilesMs = bestOf(5, [&] {
+      Sampling::TileCache cache{};
+      cache.settings().maxTilesPerFrame = 1 << 20;
+      std::vector<const Sampling::Tile *> visible{};
+      cache.collect(
+          view,
+          [&](const Sampling::Viewport &range, Sampling::Tile &tile) {
+            const std::size_t evaluations =
+                Sampling::sampleAdaptive(expr, range, {}, tile.points);
+            tile.endCurve();
+            return evaluations;
+          },
+          visible, &pool);
+      tiles.clear();
+      for (const Sampling::Tile *tile : visible)
+        tiles.insert(tiles.end(), tile->points.begin(), tile->points.end());
+    });
+
+    if (threads == 1) {
+      sweepReference = sweep;
+      tilesReference = tiles;
+      sweepBase = sweepMs;
+      tilesBase = tilesMs;
+    } else if (!samePoints(sweep, sweepReference) ||
+               !samePoints(tiles, tilesReference)) {
+      fmt::print("MISMATCH with {} threads\n", threads);
+      ++mismatches;
+    }
+
+    fmt::print("{:>8} {:>12.2f} {:>8.2f}x {:>12.2f} {:>8.2f}x\n", threads,
+               sweepMs, sweepBase / sweepMs, tilesMs, tilesBase / tilesMs);
+  }
+  return mismatches == 0 ? 0 : 1;
+}
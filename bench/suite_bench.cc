@@ -0,0 +1,273 @@
+// Times every stage from source text to a sampled frame over a corpus of
+// realistic expressions:
+//   tokenize       - Tokenizer::tokenize, per expression
+//   shunting_yard  - tokenize and convert to RPN, per expression
+//   parse          - Tokenizer::parse straight to bytecode, per expression
+//   compile        - CompiledExpression construction, per expression
+//   evaluate       - the original evaluate(): parse and walk, per sample
+//   interpret      - token walk over pre-parsed RPN, per sample
+//   eval           - CompiledExpression::eval, per sample
+//   evalBatch      - CompiledExpression::evalBatch, per sample
+//   evalDual       - CompiledExpression::evalDual, per sample
+//   uniform frame  - a cold tile cache filled the way GraphSet fills it,
+//                    all expressions on one grid, per evaluation
+//   adaptive frame - the same with adaptive sampling, per evaluation
+//
+// Every stage reports nanoseconds and heap allocations per operation, the
+// best time of a few runs. With --json the results are also written to a
+// file for tracking between releases.
+//
+// Usage: fncxx_bench [--samples N] [--json FILE]
+#include "../Grapher/Sampling.hpp"
+#include "../Grapher/TileCache.hpp"
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/Parser.hpp"
+#include "../functionParser/ThreadPool.hpp"
+#include "../functionParser/Tokenizer.hpp"
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<std::size_t> g_allocations{0};
+
+} // namespace
+
+// Every allocation in the process, on any thread, is counted.
+void *operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile double g_sink = 0;
+
+struct Result {
+  std::string stage{};
+  std::string expression{};
+  std::string op{}; ///< What one operation is
+  double nsPerOp{};
+  double allocsPerOp{};
+};
+
+// Best of a few runs of `fn`, which performs `ops` operations and returns a
+// value to keep the work from being optimised away.
+template <class Fn>
+Result measure(std::string stage, std::string expression, std::string op,
+               std::size_t ops, Fn &&fn) {
+  double best = 1e300;
+  std::size_t allocations = 0;
+  for (int run = 0; run < 3; ++run) {
+    const std::size_t before = g_allocations.load();
+    const auto start = Clock::now();
+    g_sink = g_sink + fn();
+    const auto end = Clock::now();
+    allocations = g_allocations.load() - before;
+    best = std::min(best,
+                    std::chrono::duration<double, std::nano>(end - start)
+                        .count());
+  }
+  const auto n = static_cast<double>(std::max<std::size_t>(ops, 1));
+  return {std::move(stage), std::move(expression), std::move(op), best / n,
+          static_cast<double>(allocations) / n};
+}
+
+std::string jsonString(const std::string &text) {
+  std::string out = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + '"';
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t samples = 200000;
+  std::string jsonPath{};
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--samples" && i + 1 < argc) {
+      samples = std::stoul(argv[++i]);
+    } else if (arg == "--json" && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else {
+      fmt::print(stderr, "usage: fncxx_bench [--samples N] [--json FILE]\n");
+      return 2;
+    }
+  }
+
+  const std::vector<std::string> corpus = {
+      "x",
+      "x^2+1",
+      "2*sin(x)",
+      "cos(x)+sin(x)/x",
+      "sqrt(x+3)*exp(x-1)",
+      "3*x^3-2*x^2+x-7/2",
+      "sin(x)*exp(cos(x)/3)+sqrt(x^2+1)",
+      "log(x^2+1)/(1+x^2)",
+      "tan(x/2)",
+  };
+
+  std::vector<double> xs(samples), ys(samples);
+  for (std::size_t i = 0; i < samples; ++i)
+    xs[i] = -10.0 + 20.0 * static_cast<double>(i) / samples;
+
+  std::vector<Result> results{};
+  for (const auto &expression : corpus) {
+    constexpr std::size_t kParses = 20000;
+    results.push_back(
+        measure("tokenize", expression, "expression", kParses, [&] {
+          double acc = 0;
+          for (std::size_t i = 0; i < kParses; ++i)
+            acc += Tokenizer::tokenize(expression).size();
+          return acc;
+        }));
+    results.push_back(
+        measure("shunting_yard", expression, "expression", kParses, [&] {
+          double acc = 0;
+          for (std::size_t i = 0; i < kParses; ++i)
+            acc += Tokenizer::shunting_yard(expression).size();
+          return acc;
+        }));
+    results.push_back(
+        measure("parse", expression, "expression", kParses, [&] {
+          double acc = 0;
+          for (std::size_t i = 0; i < kParses; ++i)
+            acc += Tokenizer::parse(expression).code().size();
+          return acc;
+        }));
+    results.push_back(
+        measure("compile", expression, "expression", kParses / 4, [&] {
+          double acc = 0;
+          for (std::size_t i = 0; i < kParses / 4; ++i)
+            acc += Tokenizer::CompiledExpression(expression)
+                       .program()
+                       .code()
+                       .size();
+          return acc;
+        }));
+
+    // Re-parsing is slow enough that a slice of the samples suffices.
+    const std::size_t parsed = std::min<std::size_t>(samples, 20000);
+    results.push_back(measure("evaluate", expression, "sample", parsed, [&] {
+      double acc = 0;
+      for (std::size_t i = 0; i < parsed; ++i)
+        acc += Tokenizer::evaluate<double>(expression, {{"x", xs[i]}});
+      return acc;
+    }));
+
+    const auto rpn = Tokenizer::shunting_yard(expression);
+    results.push_back(measure("interpret", expression, "sample", samples, [&] {
+      double acc = 0;
+      for (double x : xs)
+        acc += Tokenizer::interpret(rpn, {{"x", x}});
+      return acc;
+    }));
+
+    const Tokenizer::CompiledExpression compiled(expression);
+    results.push_back(measure("eval", expression, "sample", samples, [&] {
+      double acc = 0;
+      for (double x : xs)
+        acc += compiled.eval(x);
+      return acc;
+    }));
+    results.push_back(measure("evalBatch", expression, "sample", samples, [&] {
+      compiled.evalBatch(xs, ys);
+      return ys[samples / 2];
+    }));
+    results.push_back(measure("evalDual", expression, "sample", samples, [&] {
+      double acc = 0;
+      for (double x : xs)
+        acc += compiled.evalDual(x).derivative;
+      return acc;
+    }));
+  }
+
+  // A frame of the viewer's default window, from an empty cache.
+  std::vector<Tokenizer::CompiledExpression> all{};
+  for (const auto &expression : corpus)
+    all.emplace_back(expression);
+  const Sampling::Viewport view{-15, 15, -11.25, 11.25, 40, 40};
+  auto frame = [&](bool adaptive) {
+    std::size_t evaluations = 0;
+    const Result result = measure(
+        adaptive ? "adaptive frame" : "uniform frame", "corpus", "evaluation",
+        0, [&] {
+          Sampling::TileCache cache{};
+          cache.settings().maxTilesPerFrame = 1 << 20;
+          std::vector<const Sampling::Tile *> visible{};
+          evaluations = cache.collect(
+              view,
+              [&](const Sampling::Viewport &range, Sampling::Tile &tile) {
+                if (!adaptive) {
+                  const std::size_t spent =
+                      Sampling::sampleUniform(all, range, 256, tile.points);
+                  for (std::size_t c = 1; c <= all.size(); ++c)
+                    tile.ends.push_back(c * tile.points.size() / all.size());
+                  return spent;
+                }
+                std::size_t spent = 0;
+                for (const auto &expr : all) {
+                  spent += Sampling::sampleAdaptive(expr, range, {},
+                                                    tile.points);
+                  tile.endCurve();
+                }
+                return spent;
+              },
+              visible, &Tokenizer::ThreadPool::shared());
+          return static_cast<double>(visible.size());
+        });
+    // The run above counted per frame; scale to per evaluation.
+    const auto n = static_cast<double>(std::max<std::size_t>(evaluations, 1));
+    results.push_back({result.stage, result.expression, result.op,
+                       result.nsPerOp / n, result.allocsPerOp / n});
+  };
+  frame(false);
+  frame(true);
+
+  fmt::print("{:<16} {:<34} {:>12} {:>12}  {}\n", "stage", "expression",
+             "ns/op", "allocs/op", "op");
+  for (const auto &r : results)
+    fmt::print("{:<16} {:<34} {:>12.2f} {:>12.3f}  {}\n", r.stage,
+               r.expression, r.nsPerOp, r.allocsPerOp, r.op);
+
+  if (!jsonPath.empty()) {
+    std::FILE *file = std::fopen(jsonPath.c_str(), "w");
+    if (!file) {
+      fmt::print(stderr, "Cannot open {}\n", jsonPath);
+      return 1;
+    }
+    fmt::print(file, "{{\n  \"samples\": {},\n  \"threads\": {},\n",
+               samples, Tokenizer::ThreadPool::shared().threadCount());
+    fmt::print(file, "  \"results\": [\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const auto &r = results[i];
+      fmt::print(file,
+                 "    {{\"stage\": {}, \"expression\": {}, \"op\": {}, "
+                 "\"ns_per_op\": {}, \"allocs_per_op\": {}}}{}\n",
+                 jsonString(r.stage), jsonString(r.expression),
+                 jsonString(r.op), r.nsPerOp, r.allocsPerOp,
+                 i + 1 < results.size() ? "," : "");
+    }
+    fmt::print(file, "  ]\n}}\n");
+    std::fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Compares the per-sample cost of the expression evaluators:
+//   parse+walk  - the original evaluate(): shunting_yard + token walk per call
+//   walk        - token walk over a pre-parsed RPN sequence
+//   vm          - CompiledExpression::eval on the bytecode VM
+//   batch       - CompiledExpression::evalBatch
+//   jit         - CompiledExpression::eval on the native JIT backend
+//   native      - the same expression written in C++, where available
+//
+// Before timing, the JIT is checked sample by sample against
+// Tokenizer::evaluate; any difference makes the benchmark exit non-zero.
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/Tokenizer.hpp"
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Case {
+  std::string expression;
+  std::function<double(double)> native{};
+};
+
+volatile double g_sink = 0;
+
+template <class Fn>
+double nsPerSample(std::size_t samples, Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  double acc = fn();
+  auto end = std::chrono::steady_clock::now();
+  g_sink = g_sink + acc;
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         static_cast<double>(samples);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::size_t samples = (argc > 1) ? std::stoul(argv[1]) : 200000;
+  const std::vector<Case> corpus = {
+      {"x", [](double x) { return x; }},
+      {"x^2+1", [](double x) { return std::pow(x, 2) + 1; }},
+      {"2*sin(x)", [](double x) { return 2 * std::sin(x); }},
+      {"cos(x)+sin(x)/x",
+       [](double x) { return std::cos(x) + std::sin(x) / x; }},
+      {"sqrt(x+3)*exp(x-1)",
+       [](double x) { return std::sqrt(x + 3) * std::exp(x - 1); }},
+      {"3*x^3-2*x^2+x-7/2"},
+  };
+
+  std::vector<double> xs(samples), ys(samples);
+  for (std::size_t i = 0; i < samples; ++i)
+    xs[i] = -10.0 + 20.0 * static_cast<double>(i) / samples;
+
+  int mismatches = 0;
+  fmt::print("{:<22} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}\n",
+             "expression", "parse+walk", "walk", "vm", "batch", "jit",
+             "native");
+  for (const auto &c : corpus) {
+    // Re-parsing is slow enough that a slice of the samples suffices.
+    const std::size_t parsed = std::min<std::size_t>(samples, 20000);
+    double parseWalk = nsPerSample(parsed, [&] {
+      double acc = 0;
+      for (std::size_t i = 0; i < parsed; ++i)
+        acc += Tokenizer::interpret(Tokenizer::shunting_yard(c.expression),
+                                    {{"x", xs[i]}});
+      return acc;
+    });
+
+    auto rpn = Tokenizer::shunting_yard(c.expression);
+    double walk = nsPerSample(samples, [&] {
+      double acc = 0;
+      for (double x : xs)
+        acc += Tokenizer::interpret(rpn, {{"x", x}});
+      return acc;
+    });
+
+    Tokenizer::CompiledExpression compiled(c.expression);
+    double vm = nsPerSample(samples, [&] {
+      double acc = 0;
+      for (double x : xs)
+        acc += compiled.eval(x);
+      return acc;
+    });
+
+    double batch = nsPerSample(samples, [&] {
+      compiled.evalBatch(xs, ys);
+      return ys[samples / 2];
+    });
+
+    using Backend = Tokenizer::CompiledExpression::Backend;
+    std::string jit = "-";
+    Tokenizer::CompiledExpression jitted(c.expression);
+    if (jitted.setBackend(Backend::Jit) == Backend::Jit) {
+      for (std::size_t i = 0; i < samples; i += 97) {
+        double got = jitted.eval(xs[i]);
+        double want = Tokenizer::evaluate<double>(c.expression, {{"x", xs[i]}});
+        if (got != want && !(std::isnan(got) && std::isnan(want))) {
+          fmt::print(stderr, "jit mismatch: {} at x={}: {} != {}\n",
+                     c.expression, xs[i], got, want);
+          ++mismatches;
+        }
+      }
+      jit = fmt::format("{:.2f}", nsPerSample(samples, [&] {
+                          double acc = 0;
+                          for (double x : xs)
+                            acc += jitted.eval(x);
+                          return acc;
+                        }));
+    }
+
+    std::string native = "-";
+    if (c.native) {
+      native = fmt::format("{:.2f}", nsPerSample(samples, [&] {
+                             double acc = 0;
+                             for (double x : xs)
+                               acc += c.native(x);
+                             return acc;
+                           }));
+    }
+
+    fmt::print(
+        "{:<22} {:>12.2f} {:>12.2f} {:>12.2f} {:>12.2f} {:>12} {:>12}\n",
+        c.expression, parseWalk, walk, vm, batch, jit, native);
+  }
+  fmt::print("(ns per sample, {} samples)\n", samples);
+  return mismatches == 0 ? 0 : 1;
+}
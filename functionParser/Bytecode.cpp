@@ -0,0 +1,268 @@
+#include "Bytecode.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FNP_COMPUTED_GOTO 1
+#endif
+
+auto Tokenizer::opCodeForOperator(const Operator op) -> OpCode {
+  switch (op) {
+  case Operator::Sum:
+    return OpCode::Sum;
+  case Operator::Sub:
+    return OpCode::Sub;
+  case Operator::Mult:
+    return OpCode::Mult;
+  case Operator::Div:
+    return OpCode::Div;
+  case Operator::Pow:
+    return OpCode::Pow;
+  case Operator::Sine:
+    return OpCode::Sine;
+  case Operator::Cosine:
+    return OpCode::Cosine;
+  case Operator::Tan:
+    return OpCode::Tan;
+  case Operator::Exp:
+    return OpCode::Exp;
+  case Operator::Sqrt:
+    return OpCode::Sqrt;
+  case Operator::Log:
+    return OpCode::Log;
+  default:
+    throw std::runtime_error(std::string("Unexpected operator in RPN: ") +
+                             static_cast<char>(op));
+  }
+}
+
+auto Tokenizer::stackEffect(const OpCode op) noexcept -> StackEffect {
+  switch (op) {
+  case OpCode::PushConstant:
+  case OpCode::PushVariable:
+  case OpCode::LoadTemp:
+    return {0, 1};
+  case OpCode::Sum:
+  case OpCode::Sub:
+  case OpCode::Mult:
+  case OpCode::Div:
+  case OpCode::Pow:
+    return {2, 1};
+  case OpCode::Return:
+    return {1, 0};
+  default:
+    return {1, 1};
+  }
+}
+
+Tokenizer::Program
+Tokenizer::Program::compile(const std::vector<TokenType> &rpn) {
+  std::vector<Instruction> code{};
+  std::vector<std::string> variables{};
+  std::size_t depth = 0;
+
+  for (const auto &tok : rpn) {
+    Instruction ins{};
+    if (isNumber(tok)) {
+      ins.op = OpCode::PushConstant;
+      ins.constant = std::get<double>(tok);
+    } else if (isVariable(tok)) {
+      const std::string &name = std::get<Variable>(tok).name;
+      auto it = std::find(variables.begin(), variables.end(), name);
+      if (it == variables.end())
+        it = variables.insert(it, name);
+      ins.op = OpCode::PushVariable;
+      ins.slot = static_cast<std::uint32_t>(it - variables.begin());
+    } else if (isOperator(tok)) {
+      auto op = std::get<Operator>(tok);
+      ins.op = opCodeForOperator(op);
+      if (depth < static_cast<std::size_t>(stackEffect(ins.op).pops))
+        throw std::runtime_error(
+            fmt::format("Missing operand for '{}'", static_cast<char>(op)));
+    } else {
+      throw std::runtime_error("Unsupported token in RPN");
+    }
+
+    depth += stackEffect(ins.op).pushes - stackEffect(ins.op).pops;
+    code.push_back(ins);
+  }
+
+  return assemble(std::move(code), std::move(variables));
+}
+
+Tokenizer::Program
+Tokenizer::Program::assemble(std::vector<Instruction> code,
+                             std::vector<std::string> variables) {
+  if (variables.size() > kMaxSlots)
+    throw std::runtime_error("Expression uses too many variables");
+
+  Program program{};
+  std::size_t depth = 0;
+  std::vector<bool> stored{};
+  for (const auto &ins : code) {
+    auto effect = stackEffect(ins.op);
+    if (ins.op == OpCode::Return ||
+        depth < static_cast<std::size_t>(effect.pops))
+      throw std::runtime_error("Malformed expression");
+    if (ins.op == OpCode::PushVariable && ins.slot >= variables.size())
+      throw std::runtime_error("Variable slot out of range");
+    if (ins.op == OpCode::StoreTemp) {
+      if (ins.slot >= kMaxTemps)
+        throw std::runtime_error("Expression uses too many temporaries");
+      stored.resize(std::max<std::size_t>(stored.size(), ins.slot + 1));
+      stored[ins.slot] = true;
+    }
+    if (ins.op == OpCode::LoadTemp &&
+        (ins.slot >= stored.size() || !stored[ins.slot]))
+      throw std::runtime_error("Temporary loaded before it is stored");
+
+    depth += effect.pushes - effect.pops;
+    if (depth > kMaxStackDepth)
+      throw std::runtime_error("Expression is nested too deeply");
+    program.m_maxDepth = std::max(program.m_maxDepth, depth);
+  }
+
+  if (depth != 1)
+    throw std::runtime_error("Malformed expression");
+  program.m_code = std::move(code);
+  program.m_code.push_back(Instruction{OpCode::Return});
+  program.m_variables = std::move(variables);
+  program.m_tempCount = stored.size();
+  return program;
+}
+
+double Tokenizer::Program::run(const double *slots) const noexcept {
+  double stack[kMaxStackDepth];
+  double temps[kMaxTemps];
+  double *sp = stack; // next free entry
+  const Instruction *ip = m_code.data();
+
+#ifdef FNP_COMPUTED_GOTO
+  // Must list the labels in OpCode order.
+  static void *const dispatch[] = {
+      &&op_PushConstant, &&op_PushVariable, &&op_Sum,    &&op_Sub,
+      &&op_Mult,         &&op_Div,          &&op_Pow,    &&op_Sine,
+      &&op_Cosine,       &&op_Tan,          &&op_Exp,    &&op_Sqrt,
+      &&op_Log,          &&op_Square,       &&op_StoreTemp,
+      &&op_LoadTemp,     &&op_Return,
+  };
+  static_assert(sizeof(dispatch) / sizeof(dispatch[0]) ==
+                static_cast<std::size_t>(OpCode::Return) + 1);
+#define VM_OP(name) op_##name:
+#define VM_NEXT                                                                \
+  ++ip;                                                                        \
+  goto *dispatch[static_cast<std::size_t>(ip->op)]
+
+  goto *dispatch[static_cast<std::size_t>(ip->op)];
+#else
+#define VM_OP(name) case OpCode::name:
+#define VM_NEXT                                                                \
+  ++ip;                                                                        \
+  continue
+
+  for (;;)
+    switch (ip->op)
+#endif
+  {
+    VM_OP(PushConstant) {
+      *sp++ = ip->constant;
+      VM_NEXT;
+    }
+    VM_OP(PushVariable) {
+      *sp++ = slots[ip->slot];
+      VM_NEXT;
+    }
+    VM_OP(Sum) {
+      --sp;
+      sp[-1] += sp[0];
+      VM_NEXT;
+    }
+    VM_OP(Sub) {
+      --sp;
+      sp[-1] -= sp[0];
+      VM_NEXT;
+    }
+    VM_OP(Mult) {
+      --sp;
+      sp[-1] *= sp[0];
+      VM_NEXT;
+    }
+    VM_OP(Div) {
+      --sp;
+      sp[-1] /= sp[0];
+      VM_NEXT;
+    }
+    VM_OP(Pow) {
+      --sp;
+      sp[-1] = std::pow(sp[-1], sp[0]);
+      VM_NEXT;
+    }
+    VM_OP(Sine) {
+      sp[-1] = std::sin(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Cosine) {
+      sp[-1] = std::cos(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Tan) {
+      sp[-1] = std::tan(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Exp) {
+      sp[-1] = std::exp(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Sqrt) {
+      sp[-1] = std::sqrt(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Log) {
+      sp[-1] = std::log(sp[-1]);
+      VM_NEXT;
+    }
+    VM_OP(Square) {
+      sp[-1] *= sp[-1];
+      VM_NEXT;
+    }
+    VM_OP(StoreTemp) {
+      temps[ip->slot] = sp[-1];
+      VM_NEXT;
+    }
+    VM_OP(LoadTemp) {
+      *sp++ = temps[ip->slot];
+      VM_NEXT;
+    }
+    VM_OP(Return) { return stack[0]; }
+  }
+
+#undef VM_OP
+#undef VM_NEXT
+}
+
+std::size_t
+Tokenizer::Program::slotOf(std::string_view name) const noexcept {
+  auto it = std::find(m_variables.begin(), m_variables.end(), name);
+  return it == m_variables.end()
+             ? npos
+             : static_cast<std::size_t>(it - m_variables.begin());
+}
+
+double Tokenizer::execute(const std::string &expression,
+                          const std::unordered_map<std::string, double> &var_values) {
+  auto program = optimize(parse(expression));
+
+  double slots[Program::kMaxSlots]{};
+  for (const auto &[name, value] : var_values) {
+    auto slot = program.slotOf(name);
+    if (slot != Program::npos)
+      slots[slot] = value;
+  }
+  return program.run(slots);
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include "Tokenizer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tokenizer {
+
+/**
+ * @enum OpCode
+ * @brief Operations understood by the bytecode VM.
+ *
+ * Every program ends with `Return`, so the interpreter never has to check
+ * whether it ran off the end of the instruction stream.
+ */
+enum class OpCode : std::uint8_t {
+  PushConstant, ///< Push the instruction's immediate constant
+  PushVariable, ///< Push the value in the instruction's slot
+  Sum,
+  Sub,
+  Mult,
+  Div,
+  Pow,
+  Sine,
+  Cosine,
+  Tan,
+  Exp,
+  Sqrt,
+  Log,
+  Square,    ///< Multiply the top of the stack by itself
+  StoreTemp, ///< Copy the top of the stack into temporary `slot`
+  LoadTemp,  ///< Push temporary `slot`
+  Return,    ///< Stop and yield the value on top of the stack
+};
+
+/**
+ * @struct StackEffect
+ * @brief How many values an instruction pops and pushes.
+ */
+struct StackEffect {
+  int pops{};
+  int pushes{};
+};
+
+/**
+ * @brief Gets the stack effect of an operation.
+ */
+StackEffect stackEffect(const OpCode op) noexcept;
+
+/**
+ * @brief Gets the operation that applies an operator or function.
+ * @throws std::runtime_error for parentheses, commas and `None`.
+ */
+OpCode opCodeForOperator(const Operator op);
+
+/**
+ * @struct Instruction
+ * @brief A single bytecode instruction.
+ *
+ * Operands are resolved when the program is built: constants are stored
+ * inline and variables are referred to by their slot index.
+ */
+struct Instruction {
+  OpCode op{};          ///< Operation to perform
+  std::uint32_t slot{}; ///< Variable slot or temporary index
+  double constant{};    ///< Immediate value for PushConstant
+};
+static_assert(sizeof(Instruction) == 16, "Instructions should stay compact");
+
+/**
+ * @class Program
+ * @brief A contiguous instruction stream lowered from RPN.
+ *
+ * `run()` executes the program on a fixed-size value stack, dispatching with
+ * computed goto where the compiler supports it and a switch otherwise.
+ */
+class Program {
+public:
+  /// Deepest value stack a program may need.
+  static constexpr std::size_t kMaxStackDepth = 256;
+  /// Largest number of distinct variables a program may use.
+  static constexpr std::size_t kMaxSlots = 64;
+  /// Largest number of temporaries a program may use.
+  static constexpr std::size_t kMaxTemps = 256;
+  /// Returned by `slotOf()` for names the program does not use.
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  Program() = default;
+
+  /**
+   * @brief Lowers an RPN token sequence into bytecode.
+   * @param rpn Tokens as produced by `shunting_yard()`.
+   * @throws std::runtime_error if the sequence is not a valid expression.
+   */
+  static Program compile(const std::vector<TokenType> &rpn);
+
+  /**
+   * @brief Builds a program from an instruction list.
+   * @param code The instructions, without the trailing Return.
+   * @param variables Variable name for every slot the code refers to.
+   * @throws std::runtime_error if the code does not leave exactly one value
+   * on the stack, or loads a temporary before storing it.
+   */
+  static Program assemble(std::vector<Instruction> code,
+                          std::vector<std::string> variables);
+
+  /**
+   * @brief Runs the program.
+   * @param slots The value of every variable, indexed by slot.
+   * @return The value of the expression.
+   */
+  double run(const double *slots) const noexcept;
+
+  /**
+   * @brief Gets the slot a variable was resolved to.
+   * @return The slot index, or `npos` if the variable is not used.
+   */
+  std::size_t slotOf(std::string_view name) const noexcept;
+
+  /// Instructions, including the trailing Return.
+  const std::vector<Instruction> &code() const noexcept { return m_code; }
+  /// Variable name for every slot.
+  const std::vector<std::string> &variables() const noexcept {
+    return m_variables;
+  }
+  std::size_t slotCount() const noexcept { return m_variables.size(); }
+  std::size_t maxDepth() const noexcept { return m_maxDepth; }
+  std::size_t tempCount() const noexcept { return m_tempCount; }
+
+private:
+  std::vector<Instruction> m_code{};
+  std::vector<std::string> m_variables{};
+  std::size_t m_maxDepth{};
+  std::size_t m_tempCount{};
+};
+
+} // namespace Tokenizer
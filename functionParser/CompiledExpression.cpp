@@ -0,0 +1,356 @@
+#include "CompiledExpression.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+Tokenizer::CompiledExpression::CompiledExpression(const std::string &expression,
+                                                  std::string_view variable)
+    : m_source(expression),
+      m_program(optimize(parse(expression))),
+      m_values(m_program.slotCount(), 0.0),
+      m_xSlot(m_program.slotOf(variable)),
+      m_ySlot(m_program.slotOf("y")) {
+  setBackend(s_defaultBackend);
+}
+
+double Tokenizer::CompiledExpression::eval(double x) const noexcept {
+  double slots[Program::kMaxSlots];
+  std::copy(m_values.begin(), m_values.end(), slots);
+  if (m_xSlot != npos)
+    slots[m_xSlot] = x;
+  return m_jit ? (*m_jit)(slots) : m_program.run(slots);
+}
+
+double Tokenizer::CompiledExpression::eval(double x, double y) const noexcept {
+  double slots[Program::kMaxSlots];
+  std::copy(m_values.begin(), m_values.end(), slots);
+  if (m_xSlot != npos)
+    slots[m_xSlot] = x;
+  if (m_ySlot != npos)
+    slots[m_ySlot] = y;
+  return m_jit ? (*m_jit)(slots) : m_program.run(slots);
+}
+
+auto Tokenizer::CompiledExpression::evalDual(double x) const noexcept -> Dual {
+  Dual slots[Program::kMaxSlots];
+  std::transform(m_values.begin(), m_values.end(), slots,
+                 [](double value) { return Dual{value, 0}; });
+  if (m_xSlot != npos)
+    slots[m_xSlot] = {x, 1};
+  return runDual(m_program, slots);
+}
+
+auto Tokenizer::CompiledExpression::evalInterval(Interval xs) const noexcept
+    -> Interval {
+  Interval slots[Program::kMaxSlots];
+  std::transform(m_values.begin(), m_values.end(), slots, Interval::point);
+  if (m_xSlot != npos)
+    slots[m_xSlot] = xs;
+  return runInterval(m_program, slots);
+}
+
+auto Tokenizer::CompiledExpression::evalInterval(Interval xs,
+                                                 Interval ys) const noexcept
+    -> Interval {
+  Interval slots[Program::kMaxSlots];
+  std::transform(m_values.begin(), m_values.end(), slots, Interval::point);
+  if (m_xSlot != npos)
+    slots[m_xSlot] = xs;
+  if (m_ySlot != npos)
+    slots[m_ySlot] = ys;
+  return runInterval(m_program, slots);
+}
+
+auto Tokenizer::CompiledExpression::setBackend(Backend backend) -> Backend {
+  if (backend == Backend::Jit)
+    m_jit = JitFunction::compile(m_program);
+  else
+    m_jit.reset();
+  return this->backend();
+}
+
+void Tokenizer::CompiledExpression::evalBatch(std::span<const double> xs,
+                                              std::span<double> out) const {
+  evalBatch(xs, m_ySlot != npos ? m_values[m_ySlot] : 0.0, out);
+}
+
+void Tokenizer::CompiledExpression::evalBatch(std::span<const double> xs,
+                                              double y,
+                                              std::span<double> out) const {
+  assert(out.size() >= xs.size());
+  namespace simd = Tokenizer::simd;
+
+  // One row of kBatchSize values per stack entry, followed by one row per
+  // temporary. The buffer is kept per thread so steady-state batches do not
+  // allocate.
+  thread_local std::vector<double> rows{};
+  const std::size_t depth = m_program.maxDepth();
+  rows.resize(std::max(rows.size(),
+                       (depth + m_program.tempCount()) * kBatchSize));
+
+  for (std::size_t base = 0; base < xs.size(); base += kBatchSize) {
+    const std::size_t n = std::min(kBatchSize, xs.size() - base);
+    const double *x = xs.data() + base;
+    double *row = rows.data(); // next free row
+    double *temps = rows.data() + depth * kBatchSize;
+    auto arg = [&](std::size_t i) { return row - i * kBatchSize; };
+    auto temp = [&](std::size_t i) { return temps + i * kBatchSize; };
+
+    for (const auto &ins : m_program.code()) {
+      switch (ins.op) {
+      case OpCode::PushConstant:
+        simd::fill(ins.constant, row, n);
+        row += kBatchSize;
+        break;
+      case OpCode::PushVariable:
+        if (ins.slot == m_xSlot)
+          std::copy(x, x + n, row);
+        else if (ins.slot == m_ySlot)
+          simd::fill(y, row, n);
+        else
+          simd::fill(m_values[ins.slot], row, n);
+        row += kBatchSize;
+        break;
+      case OpCode::Sum:
+        simd::add(arg(2), arg(1), arg(2), n);
+        row -= kBatchSize;
+        break;
+      case OpCode::Sub:
+        simd::sub(arg(2), arg(1), arg(2), n);
+        row -= kBatchSize;
+        break;
+      case OpCode::Mult:
+        simd::mul(arg(2), arg(1), arg(2), n);
+        row -= kBatchSize;
+        break;
+      case OpCode::Div:
+        simd::div(arg(2), arg(1), arg(2), n);
+        row -= kBatchSize;
+        break;
+      case OpCode::Pow:
+        simd::pow(arg(2), arg(1), arg(2), n);
+        row -= kBatchSize;
+        break;
+      case OpCode::Sine:
+        simd::sin(arg(1), arg(1), n);
+        break;
+      case OpCode::Cosine:
+        simd::cos(arg(1), arg(1), n);
+        break;
+      case OpCode::Tan:
+        simd::tan(arg(1), arg(1), n);
+        break;
+      case OpCode::Exp:
+        simd::exp(arg(1), arg(1), n);
+        break;
+      case OpCode::Sqrt:
+        simd::sqrt(arg(1), arg(1), n);
+        break;
+      case OpCode::Log:
+        simd::log(arg(1), arg(1), n);
+        break;
+      case OpCode::Square:
+        simd::mul(arg(1), arg(1), arg(1), n);
+        break;
+      case OpCode::StoreTemp:
+        std::copy(arg(1), arg(1) + n, temp(ins.slot));
+        break;
+      case OpCode::LoadTemp:
+        std::copy(temp(ins.slot), temp(ins.slot) + n, row);
+        row += kBatchSize;
+        break;
+      case OpCode::Return:
+        break;
+      }
+    }
+
+    std::copy(rows.data(), rows.data() + n, out.data() + base);
+  }
+}
+
+void Tokenizer::CompiledExpression::evalDualBatch(
+    std::span<const double> xs, std::span<double> values,
+    std::span<double> derivatives) const {
+  assert(values.size() >= xs.size() && derivatives.size() >= xs.size());
+  namespace simd = Tokenizer::simd;
+
+  // Laid out like the rows of `evalBatch()`, except that every stack entry
+  // and temporary takes a row of values followed by a row of derivatives.
+  // One more row at the end holds intermediate results.
+  constexpr std::size_t kEntry = 2 * kBatchSize;
+  thread_local std::vector<double> rows{};
+  const std::size_t depth = m_program.maxDepth();
+  rows.resize(std::max(rows.size(),
+                       (depth + m_program.tempCount()) * kEntry + kBatchSize));
+
+  for (std::size_t base = 0; base < xs.size(); base += kBatchSize) {
+    const std::size_t n = std::min(kBatchSize, xs.size() - base);
+    const double *x = xs.data() + base;
+    double *row = rows.data(); // next free entry
+    double *temps = rows.data() + depth * kEntry;
+    double *scratch = temps + m_program.tempCount() * kEntry;
+    auto val = [&](std::size_t i) { return row - i * kEntry; };
+    auto der = [&](std::size_t i) { return row - i * kEntry + kBatchSize; };
+
+    for (const auto &ins : m_program.code()) {
+      switch (ins.op) {
+      case OpCode::PushConstant:
+        simd::fill(ins.constant, row, n);
+        simd::fill(0, row + kBatchSize, n);
+        row += kEntry;
+        break;
+      case OpCode::PushVariable:
+        if (ins.slot == m_xSlot) {
+          std::copy(x, x + n, row);
+          simd::fill(1, row + kBatchSize, n);
+        } else {
+          simd::fill(m_values[ins.slot], row, n);
+          simd::fill(0, row + kBatchSize, n);
+        }
+        row += kEntry;
+        break;
+      case OpCode::Sum:
+        simd::add(val(2), val(1), val(2), n);
+        simd::add(der(2), der(1), der(2), n);
+        row -= kEntry;
+        break;
+      case OpCode::Sub:
+        simd::sub(val(2), val(1), val(2), n);
+        simd::sub(der(2), der(1), der(2), n);
+        row -= kEntry;
+        break;
+      case OpCode::Mult: {
+        double *a = val(2), *da = der(2), *b = val(1), *db = der(1);
+        for (std::size_t i = 0; i < n; ++i) {
+          da[i] = da[i] * b[i] + a[i] * db[i];
+          a[i] *= b[i];
+        }
+        row -= kEntry;
+        break;
+      }
+      case OpCode::Div: {
+        double *a = val(2), *da = der(2), *b = val(1), *db = der(1);
+        simd::div(a, b, a, n);
+        for (std::size_t i = 0; i < n; ++i)
+          da[i] = (da[i] - a[i] * db[i]) / b[i];
+        row -= kEntry;
+        break;
+      }
+      case OpCode::Pow: {
+        double *a = val(2), *da = der(2), *b = val(1), *db = der(1);
+        simd::pow(a, b, scratch, n);
+        for (std::size_t i = 0; i < n; ++i) {
+          double d = 0;
+          if (da[i] != 0)
+            d += b[i] * std::pow(a[i], b[i] - 1) * da[i];
+          if (db[i] != 0)
+            d += scratch[i] * std::log(a[i]) * db[i];
+          da[i] = d;
+        }
+        std::copy(scratch, scratch + n, a);
+        row -= kEntry;
+        break;
+      }
+      case OpCode::Sine: {
+        double *a = val(1), *da = der(1);
+        simd::cos(a, scratch, n);
+        simd::mul(da, scratch, da, n);
+        simd::sin(a, a, n);
+        break;
+      }
+      case OpCode::Cosine: {
+        double *a = val(1), *da = der(1);
+        simd::sin(a, scratch, n);
+        for (std::size_t i = 0; i < n; ++i)
+          da[i] = -scratch[i] * da[i];
+        simd::cos(a, a, n);
+        break;
+      }
+      case OpCode::Tan: {
+        double *a = val(1), *da = der(1);
+        simd::tan(a, a, n);
+        for (std::size_t i = 0; i < n; ++i)
+          da[i] *= 1 + a[i] * a[i];
+        break;
+      }
+      case OpCode::Exp: {
+        double *a = val(1), *da = der(1);
+        simd::exp(a, a, n);
+        simd::mul(da, a, da, n);
+        break;
+      }
+      case OpCode::Sqrt: {
+        double *a = val(1), *da = der(1);
+        simd::sqrt(a, a, n);
+        for (std::size_t i = 0; i < n; ++i)
+          da[i] /= 2 * a[i];
+        break;
+      }
+      case OpCode::Log: {
+        double *a = val(1), *da = der(1);
+        simd::div(da, a, da, n);
+        simd::log(a, a, n);
+        break;
+      }
+      case OpCode::Square: {
+        double *a = val(1), *da = der(1);
+        for (std::size_t i = 0; i < n; ++i) {
+          da[i] *= 2 * a[i];
+          a[i] *= a[i];
+        }
+        break;
+      }
+      case OpCode::StoreTemp:
+        std::copy(val(1), val(1) + kEntry, temps + ins.slot * kEntry);
+        break;
+      case OpCode::LoadTemp:
+        std::copy(temps + ins.slot * kEntry, temps + (ins.slot + 1) * kEntry,
+                  row);
+        row += kEntry;
+        break;
+      case OpCode::Return:
+        break;
+      }
+    }
+
+    std::copy(rows.data(), rows.data() + n, values.data() + base);
+    std::copy(rows.data() + kBatchSize, rows.data() + kBatchSize + n,
+              derivatives.data() + base);
+  }
+}
+
+void Tokenizer::evaluateBatch(const std::string &expression,
+                              std::span<const double> xs,
+                              std::span<double> out,
+                              const std::unordered_map<std::string, double> &var_values) {
+  CompiledExpression compiled(expression);
+  for (const auto &[name, value] : var_values) {
+    if (name != "x")
+      compiled.setVariable(name, value);
+  }
+  compiled.evalBatch(xs, out);
+}
+
+bool Tokenizer::CompiledExpression::setVariable(std::string_view name,
+                                                double value) noexcept {
+  auto slot = slotOf(name);
+  if (slot == npos)
+    return false;
+  m_values[slot] = value;
+  return true;
+}
+
+void Tokenizer::CompiledExpression::setValues(
+    std::span<const double> values) noexcept {
+  assert(values.size() >= m_values.size());
+  std::copy_n(values.begin(), m_values.size(), m_values.begin());
+}
+
+std::size_t
+Tokenizer::CompiledExpression::slotOf(std::string_view name) const noexcept {
+  return m_program.slotOf(name);
+}
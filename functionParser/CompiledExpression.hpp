@@ -0,0 +1,188 @@
+#pragma once
+#include "Bytecode.hpp"
+#include "Dual.hpp"
+#include "Interval.hpp"
+#include "Jit.hpp"
+#include "Tokenizer.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Tokenizer {
+
+/**
+ * @class CompiledExpression
+ * @brief An expression parsed once and kept in executable form.
+ *
+ * The constructor parses the expression straight into a bytecode `Program`
+ * with every variable resolved to a slot and runs it through `optimize()`.
+ * `eval()` only runs that program on the VM: it neither tokenizes,
+ * allocates nor looks anything up by name.
+ */
+class CompiledExpression {
+public:
+  /**
+   * @enum Backend
+   * @brief Engine used by `eval()`.
+   */
+  enum class Backend {
+    Interpreter, ///< Bytecode VM
+    Jit,         ///< Native code, if the platform supports it
+  };
+
+  /// Number of inputs `evalBatch()` pushes through the program at a time.
+  static constexpr std::size_t kBatchSize = 256;
+  /// Returned by `slotOf()` for names the expression does not use.
+  static constexpr std::size_t npos = Program::npos;
+
+  /**
+   * @brief Compiles the given expression.
+   * @param expression The infix expression to compile.
+   * @param variable The variable that `eval()`, `evalBatch()` and
+   * `evalInterval()` bind their argument to, e.g. `t` for a parametric
+   * curve. The rest of this class calls it `x`.
+   * @throws std::runtime_error if the expression is malformed.
+   */
+  explicit CompiledExpression(const std::string &expression,
+                              std::string_view variable = "x");
+
+  /**
+   * @brief Evaluates the expression with `x` bound to the given value.
+   *
+   * Any other variable evaluates to the value last given to `setVariable()`,
+   * or 0 if it was never set.
+   */
+  double eval(double x) const noexcept;
+
+  /**
+   * @brief Evaluates the expression with `x` and `y` bound to the given
+   * values, e.g. for the implicit curve f(x, y) = 0.
+   */
+  double eval(double x, double y) const noexcept;
+
+  /**
+   * @brief Evaluates the expression for every value in `xs`.
+   *
+   * Inputs are processed in blocks of `kBatchSize`; each instruction runs as
+   * one array kernel over the whole block. Results match `eval()` exactly.
+   *
+   * @param xs Values bound to `x`.
+   * @param out Receives f(xs[i]) at index i; must be at least as long as xs.
+   */
+  void evalBatch(std::span<const double> xs, std::span<double> out) const;
+
+  /**
+   * @brief Evaluates the expression for every value in `xs` with `y` bound
+   * to the given value, e.g. along one row of a grid.
+   */
+  void evalBatch(std::span<const double> xs, double y,
+                 std::span<double> out) const;
+
+  /**
+   * @brief Evaluates the expression and its derivative with respect to `x`
+   * in one pass; see `runDual()`.
+   *
+   * The value matches `eval()` exactly. Other variables are held constant.
+   */
+  Dual evalDual(double x) const noexcept;
+
+  /**
+   * @brief Evaluates the expression and its derivative with respect to `x`
+   * for every value in `xs`, a batch at a time like `evalBatch()`.
+   *
+   * @param values Receives f(xs[i]) at index i; must be at least as long as
+   * xs.
+   * @param derivatives Receives f'(xs[i]) at index i; must be at least as
+   * long as xs.
+   */
+  void evalDualBatch(std::span<const double> xs, std::span<double> values,
+                     std::span<double> derivatives) const;
+
+  /**
+   * @brief Bounds the expression over a range of `x`.
+   *
+   * Other variables keep the values given to `setVariable()`.
+   *
+   * @return A range holding every finite f(x) with x in `xs`; see
+   * `runInterval()`. It is empty if f has no finite value there and has an
+   * infinite bound if f may grow without limit, e.g. across a pole.
+   */
+  Interval evalInterval(Interval xs) const noexcept;
+
+  /**
+   * @brief Bounds the expression over a box of `x` and `y`.
+   */
+  Interval evalInterval(Interval xs, Interval ys) const noexcept;
+
+  /**
+   * @brief Selects the engine used by `eval()`.
+   *
+   * Requesting `Backend::Jit` falls back to the interpreter when native code
+   * cannot be generated for this program or platform.
+   *
+   * @return The backend actually in use.
+   */
+  Backend setBackend(Backend backend);
+  Backend backend() const noexcept {
+    return m_jit ? Backend::Jit : Backend::Interpreter;
+  }
+
+  /**
+   * @brief Sets the backend newly compiled expressions start with.
+   */
+  static void setDefaultBackend(Backend backend) noexcept {
+    s_defaultBackend = backend;
+  }
+
+  /**
+   * @brief Binds a value to a variable other than `x`.
+   * @return false if the expression does not use the variable.
+   */
+  bool setVariable(std::string_view name, double value) noexcept;
+
+  /**
+   * @brief Binds a value to every variable at once.
+   *
+   * Binding by slot is a plain array copy, with no lookup by name; the
+   * value for the slot of `x` is replaced by the argument of each call.
+   *
+   * @param values One value per slot, in the order of `variables()`.
+   */
+  void setValues(std::span<const double> values) noexcept;
+
+  /// Value bound to every slot.
+  std::span<const double> values() const noexcept { return m_values; }
+
+  /**
+   * @brief Gets the slot a variable was resolved to.
+   * @return The slot index, or `npos` if the variable is not used.
+   */
+  std::size_t slotOf(std::string_view name) const noexcept;
+
+  /// Slot of the variable bound to the argument, or `npos` if unused.
+  std::size_t xSlot() const noexcept { return m_xSlot; }
+
+  /// Variable name for every slot.
+  const std::vector<std::string> &variables() const noexcept {
+    return m_program.variables();
+  }
+
+  const std::string &source() const noexcept { return m_source; }
+  const Program &program() const noexcept { return m_program; }
+
+private:
+  std::string m_source{};
+  Program m_program{};
+  std::vector<double> m_values{}; ///< Bound value for every slot
+  std::size_t m_xSlot{npos}; ///< Slot of the bound variable
+  std::size_t m_ySlot{npos};
+  std::shared_ptr<const JitFunction> m_jit{};
+
+  inline static Backend s_defaultBackend{Backend::Interpreter};
+};
+
+} // namespace Tokenizer
@@ -0,0 +1,96 @@
+#include "Dual.hpp"
+
+#include <cmath>
+
+Tokenizer::Dual Tokenizer::runDual(const Program &program,
+                                   const Dual *slots) noexcept {
+  Dual stack[Program::kMaxStackDepth];
+  Dual temps[Program::kMaxTemps];
+  Dual *sp = stack; // next free entry
+
+  for (const auto &ins : program.code()) {
+    Dual &top = sp[-1];
+    switch (ins.op) {
+    case OpCode::PushConstant:
+      *sp++ = {ins.constant, 0};
+      break;
+    case OpCode::PushVariable:
+      *sp++ = slots[ins.slot];
+      break;
+    case OpCode::Sum:
+      --sp;
+      sp[-1] = {sp[-1].value + sp[0].value,
+                sp[-1].derivative + sp[0].derivative};
+      break;
+    case OpCode::Sub:
+      --sp;
+      sp[-1] = {sp[-1].value - sp[0].value,
+                sp[-1].derivative - sp[0].derivative};
+      break;
+    case OpCode::Mult:
+      --sp;
+      sp[-1] = {sp[-1].value * sp[0].value,
+                sp[-1].derivative * sp[0].value +
+                    sp[-1].value * sp[0].derivative};
+      break;
+    case OpCode::Div: {
+      --sp;
+      const double value = sp[-1].value / sp[0].value;
+      sp[-1] = {value,
+                (sp[-1].derivative - value * sp[0].derivative) / sp[0].value};
+      break;
+    }
+    case OpCode::Pow: {
+      --sp;
+      const Dual a = sp[-1];
+      const Dual b = sp[0];
+      const double value = std::pow(a.value, b.value);
+      // Each term is left out when its factor is zero, so a constant
+      // exponent never takes the log of a negative base and vice versa.
+      double derivative = 0;
+      if (a.derivative != 0)
+        derivative += b.value * std::pow(a.value, b.value - 1) * a.derivative;
+      if (b.derivative != 0)
+        derivative += value * std::log(a.value) * b.derivative;
+      sp[-1] = {value, derivative};
+      break;
+    }
+    case OpCode::Sine:
+      top = {std::sin(top.value), std::cos(top.value) * top.derivative};
+      break;
+    case OpCode::Cosine:
+      top = {std::cos(top.value), -std::sin(top.value) * top.derivative};
+      break;
+    case OpCode::Tan: {
+      const double value = std::tan(top.value);
+      top = {value, (1 + value * value) * top.derivative};
+      break;
+    }
+    case OpCode::Exp: {
+      const double value = std::exp(top.value);
+      top = {value, value * top.derivative};
+      break;
+    }
+    case OpCode::Sqrt: {
+      const double value = std::sqrt(top.value);
+      top = {value, top.derivative / (2 * value)};
+      break;
+    }
+    case OpCode::Log:
+      top = {std::log(top.value), top.derivative / top.value};
+      break;
+    case OpCode::Square:
+      top = {top.value * top.value, 2 * top.value * top.derivative};
+      break;
+    case OpCode::StoreTemp:
+      temps[ins.slot] = top;
+      break;
+    case OpCode::LoadTemp:
+      *sp++ = temps[ins.slot];
+      break;
+    case OpCode::Return:
+      return stack[0];
+    }
+  }
+  return stack[0];
+}
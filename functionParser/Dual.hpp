@@ -0,0 +1,31 @@
+#pragma once
+#include "Bytecode.hpp"
+
+namespace Tokenizer {
+
+/**
+ * @struct Dual
+ * @brief A value together with its derivative with respect to one variable.
+ */
+struct Dual {
+  double value;
+  double derivative;
+};
+
+/**
+ * @brief Runs a program in forward-mode automatic differentiation.
+ *
+ * Every instruction carries the derivative of its result along with the
+ * value by the chain rule, so one pass yields f and f'. Values match
+ * `Program::run()` exactly; the derivative is exact up to rounding, with
+ * no step size to choose. Where f is not differentiable the derivative is
+ * whatever the rules give, typically infinite or NaN.
+ *
+ * @param program The program to run.
+ * @param slots The value of every variable and its derivative, indexed by
+ * slot: 1 for the variable differentiated by, 0 for the others.
+ * @return The value of the expression and its derivative.
+ */
+Dual runDual(const Program &program, const Dual *slots) noexcept;
+
+} // namespace Tokenizer
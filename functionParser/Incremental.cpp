@@ -0,0 +1,158 @@
+#include "Incremental.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+using Tokenizer::OpCode;
+namespace simd = Tokenizer::simd;
+
+static_assert(Tokenizer::Program::kMaxSlots <= 64,
+              "Dependencies are tracked in a 64-bit mask");
+
+// The kernel `evalBatch()` runs for the operation, so results agree.
+void apply(OpCode op, const double *a, const double *b, double *out,
+           std::size_t n) noexcept {
+  switch (op) {
+  case OpCode::Sum:
+    simd::add(a, b, out, n);
+    break;
+  case OpCode::Sub:
+    simd::sub(a, b, out, n);
+    break;
+  case OpCode::Mult:
+    simd::mul(a, b, out, n);
+    break;
+  case OpCode::Div:
+    simd::div(a, b, out, n);
+    break;
+  case OpCode::Pow:
+    simd::pow(a, b, out, n);
+    break;
+  case OpCode::Sine:
+    simd::sin(a, out, n);
+    break;
+  case OpCode::Cosine:
+    simd::cos(a, out, n);
+    break;
+  case OpCode::Tan:
+    simd::tan(a, out, n);
+    break;
+  case OpCode::Exp:
+    simd::exp(a, out, n);
+    break;
+  case OpCode::Sqrt:
+    simd::sqrt(a, out, n);
+    break;
+  case OpCode::Log:
+    simd::log(a, out, n);
+    break;
+  case OpCode::Square:
+    simd::mul(a, a, out, n);
+    break;
+  default:
+    break;
+  }
+}
+} // namespace
+
+Tokenizer::IncrementalEvaluator::IncrementalEvaluator(
+    const CompiledExpression &expression)
+    : m_xSlot(expression.xSlot()) {
+  m_root = m_ast.append(expression.program());
+
+  const std::size_t nodes = m_ast.size();
+  const std::uint64_t xBit =
+      m_xSlot == CompiledExpression::npos ? 0 : std::uint64_t{1} << m_xSlot;
+  m_dependsOn.resize(nodes);
+  m_rowOf.assign(nodes, kScalar);
+  m_scalars.resize(nodes);
+  for (types::NodeId id = 0; id < nodes; ++id) {
+    const types::Node &node = m_ast[id];
+    std::uint64_t mask = 0;
+    if (node.op == OpCode::PushVariable)
+      mask = std::uint64_t{1} << node.slot;
+    else if (node.op != OpCode::PushConstant)
+      mask = m_dependsOn[node.lhs] |
+             (node.rhs == types::kNoNode ? 0 : m_dependsOn[node.rhs]);
+    m_dependsOn[id] = mask;
+    if (mask & xBit)
+      m_rowOf[id] = m_rowCount++;
+  }
+  m_values.resize(expression.program().slotCount());
+}
+
+void Tokenizer::IncrementalEvaluator::setGrid(std::span<const double> xs) {
+  m_grid.assign(xs.begin(), xs.end());
+  m_rows.resize(m_rowCount * xs.size());
+  m_scratch.resize(2 * xs.size());
+  m_valid = false;
+}
+
+auto Tokenizer::IncrementalEvaluator::evaluate(std::span<const double> values)
+    -> std::span<const double> {
+  assert(values.size() >= m_values.size());
+
+  // A slot is dirty if its bits changed, so NaN compares as unchanged.
+  std::uint64_t dirty = 0;
+  for (std::size_t slot = 0; slot < m_values.size(); ++slot)
+    if (slot != m_xSlot &&
+        std::memcmp(&values[slot], &m_values[slot], sizeof(double)) != 0)
+      dirty |= std::uint64_t{1} << slot;
+  std::copy_n(values.begin(), m_values.size(), m_values.begin());
+
+  m_recomputed = 0;
+  m_evaluations = 0;
+  for (types::NodeId id = 0; id < m_ast.size(); ++id)
+    if (!m_valid || (m_dependsOn[id] & dirty))
+      compute(id);
+  m_valid = true;
+
+  const std::size_t n = m_grid.size();
+  if (m_rowOf[m_root] != kScalar)
+    return {row(m_rowOf[m_root]), n};
+  simd::fill(m_scalars[m_root], m_scratch.data(), n);
+  return {m_scratch.data(), n};
+}
+
+const double *
+Tokenizer::IncrementalEvaluator::operand(types::NodeId id,
+                                         double *scratch) noexcept {
+  if (m_rowOf[id] != kScalar)
+    return row(m_rowOf[id]);
+  simd::fill(m_scalars[id], scratch, m_grid.size());
+  return scratch;
+}
+
+void Tokenizer::IncrementalEvaluator::compute(types::NodeId id) {
+  const types::Node &node = m_ast[id];
+  ++m_recomputed;
+
+  if (m_rowOf[id] == kScalar) {
+    double &out = m_scalars[id];
+    if (node.op == OpCode::PushConstant)
+      out = node.constant;
+    else if (node.op == OpCode::PushVariable)
+      out = m_values[node.slot];
+    else
+      apply(node.op, &m_scalars[node.lhs],
+            node.rhs == types::kNoNode ? nullptr : &m_scalars[node.rhs], &out,
+            1);
+    return;
+  }
+
+  const std::size_t n = m_grid.size();
+  double *out = row(m_rowOf[id]);
+  m_evaluations += n;
+  if (node.op == OpCode::PushVariable) {
+    std::copy(m_grid.begin(), m_grid.end(), out);
+    return;
+  }
+  const double *a = operand(node.lhs, m_scratch.data());
+  const double *b = node.rhs == types::kNoNode
+                        ? nullptr
+                        : operand(node.rhs, m_scratch.data() + n);
+  apply(node.op, a, b, out, n);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "CompiledExpression.hpp"
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Tokenizer {
+
+/**
+ * @class IncrementalEvaluator
+ * @brief Evaluates an expression over a fixed grid of `x` and, when other
+ * variables change, redoes only the work that depends on them.
+ *
+ * The optimized program is rebuilt as a DAG in a `types::Ast`, and every
+ * node records the slots it depends on. Nodes that depend on `x` keep one
+ * value per grid point; the others keep a single value. Each call to
+ * `evaluate()` recomputes only the nodes that depend on a slot whose value
+ * changed since the last call. In `a*sin(x)+b`, moving `a` redoes the
+ * product and the sum, while `sin(x)` stays as it was.
+ *
+ * Results match `CompiledExpression::evalBatch()` bit for bit.
+ */
+class IncrementalEvaluator {
+public:
+  /**
+   * @brief Prepares to evaluate `expression`.
+   *
+   * Only the expression's program and its `x` slot are kept; values are
+   * passed to every `evaluate()`.
+   */
+  explicit IncrementalEvaluator(const CompiledExpression &expression);
+
+  /// Sets the points to evaluate at; the next evaluation redoes everything.
+  void setGrid(std::span<const double> xs);
+  std::span<const double> grid() const noexcept { return m_grid; }
+
+  /**
+   * @brief Evaluates the expression at every grid point.
+   * @param values The value of every slot, as in
+   * `CompiledExpression::values()`; the one for `x` is ignored.
+   * @return f at every grid point, valid until the next non-const call.
+   */
+  std::span<const double> evaluate(std::span<const double> values);
+
+  /// Nodes the last `evaluate()` recomputed.
+  std::size_t recomputed() const noexcept { return m_recomputed; }
+  /// Grid points times the nodes with a value per point that it recomputed.
+  std::size_t evaluations() const noexcept { return m_evaluations; }
+  std::size_t nodeCount() const noexcept { return m_ast.size(); }
+
+private:
+  /// Row index of nodes that keep a single value.
+  static constexpr std::uint32_t kScalar = ~std::uint32_t{0};
+
+  double *row(std::uint32_t index) noexcept {
+    return m_rows.data() + static_cast<std::size_t>(index) * m_grid.size();
+  }
+  // The node's values, or its single value broadcast into `scratch`.
+  const double *operand(types::NodeId id, double *scratch) noexcept;
+  void compute(types::NodeId id);
+
+  types::Ast m_ast{};
+  types::NodeId m_root{};
+  std::size_t m_xSlot{};
+  std::vector<std::uint64_t> m_dependsOn{}; ///< Slot mask of every node
+  std::vector<std::uint32_t> m_rowOf{};     ///< Row of every node
+  std::uint32_t m_rowCount{};               ///< Nodes that depend on `x`
+  std::vector<double> m_scalars{};          ///< Value of single-valued nodes
+  std::vector<double> m_rows{};             ///< Values of the other nodes
+  std::vector<double> m_scratch{};          ///< Two rows for broadcasts
+  std::vector<double> m_grid{};
+  std::vector<double> m_values{}; ///< Slot values of the last evaluation
+  bool m_valid{};
+  std::size_t m_recomputed{};
+  std::size_t m_evaluations{};
+};
+
+} // namespace Tokenizer
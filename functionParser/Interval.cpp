@@ -0,0 +1,246 @@
+#include "Interval.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace {
+using Tokenizer::Interval;
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+double down(double v) { return std::nextafter(v, -kInf); }
+double up(double v) { return std::nextafter(v, kInf); }
+
+// Rounds the bounds outwards. A NaN bound comes from inf - inf or similar
+// and means nothing is known on that side.
+Interval outward(double lo, double hi, int ulps = 1) {
+  if (std::isnan(lo))
+    lo = -kInf;
+  if (std::isnan(hi))
+    hi = kInf;
+  for (int i = 0; i < ulps; ++i) {
+    lo = down(lo);
+    hi = up(hi);
+  }
+  return {lo, hi};
+}
+
+// libm results are within an ulp of the true value, so they are widened by
+// one more.
+Interval libm(double lo, double hi) { return outward(lo, hi, 2); }
+
+bool containsZero(const Interval &a) { return a.lo <= 0 && 0 <= a.hi; }
+
+// A product in which a zero factor wins over an infinite one, as it does
+// for every finite value the infinite bound stands for.
+double times(double a, double b) { return (a == 0 || b == 0) ? 0 : a * b; }
+
+// Whether some offset + k * period, for an integer k, lies in [lo, hi].
+// Errs towards yes, which only makes the bound looser.
+bool hitsPeriodic(const Interval &a, double offset, double period) {
+  const double slack =
+      1e-9 * std::max({1.0, std::abs(a.lo), std::abs(a.hi)}) / period;
+  return std::floor((a.hi - offset) / period + slack) >=
+         std::ceil((a.lo - offset) / period - slack);
+}
+
+Interval add(const Interval &a, const Interval &b) {
+  return outward(a.lo + b.lo, a.hi + b.hi);
+}
+
+Interval sub(const Interval &a, const Interval &b) {
+  return outward(a.lo - b.hi, a.hi - b.lo);
+}
+
+Interval mul(const Interval &a, const Interval &b) {
+  const double p[] = {times(a.lo, b.lo), times(a.lo, b.hi), times(a.hi, b.lo),
+                      times(a.hi, b.hi)};
+  return outward(*std::min_element(std::begin(p), std::end(p)),
+                 *std::max_element(std::begin(p), std::end(p)));
+}
+
+Interval div(const Interval &a, const Interval &b) {
+  if (b.lo == 0 && b.hi == 0)
+    return Interval::empty();
+  if (containsZero(b))
+    return Interval::entire();
+  return mul(a, outward(1 / b.hi, 1 / b.lo));
+}
+
+Interval square(const Interval &a) {
+  const double l = a.lo * a.lo;
+  const double h = a.hi * a.hi;
+  if (containsZero(a))
+    return {0, up(std::max(l, h))};
+  return outward(std::min(l, h), std::max(l, h));
+}
+
+Interval sqrt(const Interval &a) {
+  if (a.hi < 0)
+    return Interval::empty();
+  return {std::max(0.0, down(std::sqrt(std::max(a.lo, 0.0)))),
+          up(std::sqrt(a.hi))};
+}
+
+Interval exp(const Interval &a) {
+  const Interval r = libm(std::exp(a.lo), std::exp(a.hi));
+  return {std::max(0.0, r.lo), r.hi};
+}
+
+Interval log(const Interval &a) {
+  if (a.hi <= 0)
+    return Interval::empty();
+  if (a.lo <= 0)
+    return {-kInf, libm(0, std::log(a.hi)).hi};
+  return libm(std::log(a.lo), std::log(a.hi));
+}
+
+Interval sin(const Interval &a) {
+  constexpr double pi = std::numbers::pi;
+  if (!(a.hi - a.lo < 2 * pi))
+    return {-1, 1};
+  const Interval r = libm(std::min(std::sin(a.lo), std::sin(a.hi)),
+                          std::max(std::sin(a.lo), std::sin(a.hi)));
+  return {hitsPeriodic(a, -pi / 2, 2 * pi) ? -1 : std::max(-1.0, r.lo),
+          hitsPeriodic(a, pi / 2, 2 * pi) ? 1 : std::min(1.0, r.hi)};
+}
+
+Interval cos(const Interval &a) {
+  constexpr double pi = std::numbers::pi;
+  if (!(a.hi - a.lo < 2 * pi))
+    return {-1, 1};
+  const Interval r = libm(std::min(std::cos(a.lo), std::cos(a.hi)),
+                          std::max(std::cos(a.lo), std::cos(a.hi)));
+  return {hitsPeriodic(a, pi, 2 * pi) ? -1 : std::max(-1.0, r.lo),
+          hitsPeriodic(a, 0, 2 * pi) ? 1 : std::min(1.0, r.hi)};
+}
+
+Interval tan(const Interval &a) {
+  constexpr double pi = std::numbers::pi;
+  // tan increases between its poles, so anything that does not reach one
+  // is bounded by its ends.
+  if (!(a.hi - a.lo < pi) || hitsPeriodic(a, pi / 2, pi))
+    return Interval::entire();
+  return libm(std::tan(a.lo), std::tan(a.hi));
+}
+
+// a^n for an integer n > 0.
+Interval powInteger(const Interval &a, double n) {
+  if (std::fmod(n, 2) != 0)
+    return libm(std::pow(a.lo, n), std::pow(a.hi, n));
+  const double l = std::pow(std::abs(a.lo), n);
+  const double h = std::pow(std::abs(a.hi), n);
+  if (containsZero(a))
+    return {0, libm(0, std::max(l, h)).hi};
+  const Interval r = libm(std::min(l, h), std::max(l, h));
+  return {std::max(0.0, r.lo), r.hi};
+}
+
+Interval pow(const Interval &a, const Interval &b) {
+  if (b.lo == b.hi && std::trunc(b.lo) == b.lo) {
+    if (b.lo == 0)
+      return Interval::point(1);
+    if (b.lo > 0)
+      return powInteger(a, b.lo);
+    return div(Interval::point(1), powInteger(a, -b.lo));
+  }
+  if (a.lo > 0)
+    return exp(mul(b, log(a)));
+  if (a.hi < 0 && b.lo == b.hi)
+    return Interval::empty(); // a negative base to a fractional power
+  return Interval::entire();
+}
+} // namespace
+
+Tokenizer::Interval Tokenizer::runInterval(const Program &program,
+                                           const Interval *slots) noexcept {
+  Interval stack[Program::kMaxStackDepth];
+  Interval temps[Program::kMaxTemps];
+  Interval *sp = stack; // next free entry
+
+  for (const auto &ins : program.code()) {
+    switch (ins.op) {
+    case OpCode::PushConstant:
+      *sp++ = std::isnan(ins.constant) ? Interval::empty()
+                                       : Interval::point(ins.constant);
+      continue;
+    case OpCode::PushVariable:
+      *sp++ = slots[ins.slot];
+      continue;
+    case OpCode::LoadTemp:
+      *sp++ = temps[ins.slot];
+      continue;
+    case OpCode::StoreTemp:
+      temps[ins.slot] = sp[-1];
+      continue;
+    case OpCode::Return:
+      return stack[0];
+    default:
+      break;
+    }
+
+    // Nothing downstream of an empty range is finite either.
+    if (stackEffect(ins.op).pops == 2) {
+      --sp;
+      const Interval a = sp[-1];
+      const Interval b = sp[0];
+      if (a.isEmpty() || b.isEmpty()) {
+        sp[-1] = Interval::empty();
+        continue;
+      }
+      switch (ins.op) {
+      case OpCode::Sum:
+        sp[-1] = add(a, b);
+        break;
+      case OpCode::Sub:
+        sp[-1] = sub(a, b);
+        break;
+      case OpCode::Mult:
+        sp[-1] = mul(a, b);
+        break;
+      case OpCode::Div:
+        sp[-1] = div(a, b);
+        break;
+      case OpCode::Pow:
+        sp[-1] = pow(a, b);
+        break;
+      default:
+        sp[-1] = Interval::entire();
+        break;
+      }
+      continue;
+    }
+
+    const Interval a = sp[-1];
+    if (a.isEmpty())
+      continue;
+    switch (ins.op) {
+    case OpCode::Sine:
+      sp[-1] = sin(a);
+      break;
+    case OpCode::Cosine:
+      sp[-1] = cos(a);
+      break;
+    case OpCode::Tan:
+      sp[-1] = tan(a);
+      break;
+    case OpCode::Exp:
+      sp[-1] = exp(a);
+      break;
+    case OpCode::Sqrt:
+      sp[-1] = sqrt(a);
+      break;
+    case OpCode::Log:
+      sp[-1] = log(a);
+      break;
+    case OpCode::Square:
+      sp[-1] = square(a);
+      break;
+    default:
+      sp[-1] = Interval::entire();
+      break;
+    }
+  }
+  return stack[0];
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Bytecode.hpp"
+
+#include <limits>
+
+namespace Tokenizer {
+
+/**
+ * @struct Interval
+ * @brief A closed range [lo, hi] of doubles.
+ *
+ * Bounds only describe finite values: an operation that is undefined or
+ * infinite over its whole input is `empty()`, and one whose values are not
+ * bounded on some side has an infinite bound there.
+ */
+struct Interval {
+  double lo;
+  double hi;
+
+  static constexpr Interval point(double value) noexcept {
+    return {value, value};
+  }
+  static constexpr Interval entire() noexcept {
+    return {-std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::infinity()};
+  }
+  static constexpr Interval empty() noexcept {
+    return {std::numeric_limits<double>::infinity(),
+            -std::numeric_limits<double>::infinity()};
+  }
+
+  bool isEmpty() const noexcept { return !(lo <= hi); }
+  /// True if both bounds are finite; an empty interval is bounded.
+  bool isBounded() const noexcept {
+    return isEmpty() || (lo > -std::numeric_limits<double>::infinity() &&
+                         hi < std::numeric_limits<double>::infinity());
+  }
+};
+
+/**
+ * @brief Runs a program in interval arithmetic.
+ *
+ * Every instruction maps the ranges of its operands to a range that holds
+ * all of its finite results. Bounds are rounded outwards, and by two ulps
+ * for the libm functions, so the result is guaranteed to contain f(x) for
+ * every combination of slot values, wherever f(x) is finite. It may be
+ * wider than the true range: every occurrence of a variable is treated as
+ * independent, and `pow` with a base that reaches zero or below and an
+ * exponent that is not a single integer gives up on any bound at all.
+ *
+ * @param program The program to run.
+ * @param slots The range of every variable, indexed by slot.
+ * @return The range of the expression.
+ */
+Interval runInterval(const Program &program, const Interval *slots) noexcept;
+
+} // namespace Tokenizer
@@ -0,0 +1,246 @@
+#include "Jit.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define FNP_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef FNP_JIT_X86_64
+namespace {
+using Tokenizer::OpCode;
+
+// Out-of-line wrappers give the generated code a plain function address and
+// guarantee the same libm entry points as the interpreter.
+double callPow(double a, double b) { return std::pow(a, b); }
+double callSin(double a) { return std::sin(a); }
+double callCos(double a) { return std::cos(a); }
+double callTan(double a) { return std::tan(a); }
+double callExp(double a) { return std::exp(a); }
+double callLog(double a) { return std::log(a); }
+
+/**
+ * Emits the handful of SSE2 instructions the code generator needs. Register
+ * use is fixed: rbx holds the slot pointer, rax is scratch, xmm0 caches the
+ * top of the value stack and xmm1 holds the right-hand operand.
+ */
+class Assembler {
+public:
+  void bytes(std::initializer_list<std::uint8_t> b) {
+    m_code.insert(m_code.end(), b);
+  }
+  void imm32(std::uint32_t v) { append(&v, sizeof v); }
+  void imm64(std::uint64_t v) { append(&v, sizeof v); }
+
+  void prologue(std::uint32_t frame) {
+    bytes({0x53});             // push rbx
+    bytes({0x48, 0x89, 0xFB}); // mov rbx, rdi
+    bytes({0x48, 0x81, 0xEC}); // sub rsp, imm32
+    imm32(frame);
+  }
+  void epilogue(std::uint32_t frame) {
+    bytes({0x48, 0x81, 0xC4}); // add rsp, imm32
+    imm32(frame);
+    bytes({0x5B}); // pop rbx
+    bytes({0xC3}); // ret
+  }
+
+  // movsd [rsp + disp], xmm0
+  void spill(std::uint32_t disp) {
+    bytes({0xF2, 0x0F, 0x11, 0x84, 0x24});
+    imm32(disp);
+  }
+  // movsd xmm0, [rsp + disp]
+  void reload(std::uint32_t disp) {
+    bytes({0xF2, 0x0F, 0x10, 0x84, 0x24});
+    imm32(disp);
+  }
+  // movsd xmm0, [rbx + disp]
+  void loadSlot(std::uint32_t disp) {
+    bytes({0xF2, 0x0F, 0x10, 0x83});
+    imm32(disp);
+  }
+  // mov rax, imm64; movq xmm0, rax
+  void loadConstant(double value) {
+    std::uint64_t bits{};
+    std::memcpy(&bits, &value, sizeof bits);
+    bytes({0x48, 0xB8});
+    imm64(bits);
+    bytes({0x66, 0x48, 0x0F, 0x6E, 0xC0});
+  }
+  // movapd xmm1, xmm0
+  void moveToRhs() { bytes({0x66, 0x0F, 0x28, 0xC8}); }
+  // <op>sd xmm0, xmm1 for 0x58 add, 0x5C sub, 0x59 mul, 0x5E div
+  void arith(std::uint8_t opcode) { bytes({0xF2, 0x0F, opcode, 0xC1}); }
+  // sqrtsd xmm0, xmm0
+  void sqrt() { bytes({0xF2, 0x0F, 0x51, 0xC0}); }
+  // mulsd xmm0, xmm0
+  void square() { bytes({0xF2, 0x0F, 0x59, 0xC0}); }
+  // mov rax, imm64; call rax
+  void call(const void *fn) {
+    bytes({0x48, 0xB8});
+    imm64(reinterpret_cast<std::uint64_t>(fn));
+    bytes({0xFF, 0xD0});
+  }
+
+  const std::vector<std::uint8_t> &code() const noexcept { return m_code; }
+
+private:
+  void append(const void *p, std::size_t n) {
+    auto b = static_cast<const std::uint8_t *>(p);
+    m_code.insert(m_code.end(), b, b + n);
+  }
+
+  std::vector<std::uint8_t> m_code{};
+};
+
+template <class Fn> const void *address(Fn *fn) {
+  return reinterpret_cast<const void *>(fn);
+}
+
+/// Returns false if the program contains an instruction the JIT cannot emit.
+bool generate(const Tokenizer::Program &program, Assembler &as) {
+  // The frame holds every stack entry below the top, followed by the
+  // temporaries. rsp is 16-byte aligned after `push rbx`, so keeping the
+  // frame a multiple of 16 keeps calls aligned as the ABI requires.
+  const auto temps = static_cast<std::uint32_t>(program.maxDepth());
+  const auto frame = static_cast<std::uint32_t>(
+      (((program.maxDepth() + program.tempCount()) * sizeof(double)) + 15) &
+      ~std::size_t{15});
+  as.prologue(frame);
+
+  std::uint32_t depth = 0;
+  auto entry = [](std::uint32_t index) {
+    return index * static_cast<std::uint32_t>(sizeof(double));
+  };
+  auto binary = [&] {
+    as.moveToRhs();
+    as.reload(entry(depth - 2));
+    --depth;
+  };
+
+  for (const auto &ins : program.code()) {
+    switch (ins.op) {
+    case OpCode::PushConstant:
+      if (depth > 0)
+        as.spill(entry(depth - 1));
+      as.loadConstant(ins.constant);
+      ++depth;
+      break;
+    case OpCode::PushVariable:
+      if (depth > 0)
+        as.spill(entry(depth - 1));
+      as.loadSlot(ins.slot * static_cast<std::uint32_t>(sizeof(double)));
+      ++depth;
+      break;
+    case OpCode::Sum:
+      binary();
+      as.arith(0x58);
+      break;
+    case OpCode::Sub:
+      binary();
+      as.arith(0x5C);
+      break;
+    case OpCode::Mult:
+      binary();
+      as.arith(0x59);
+      break;
+    case OpCode::Div:
+      binary();
+      as.arith(0x5E);
+      break;
+    case OpCode::Pow:
+      binary();
+      as.call(address(&callPow));
+      break;
+    case OpCode::Sqrt:
+      as.sqrt();
+      break;
+    case OpCode::Square:
+      as.square();
+      break;
+    case OpCode::StoreTemp:
+      as.spill(entry(temps + ins.slot));
+      break;
+    case OpCode::LoadTemp:
+      if (depth > 0)
+        as.spill(entry(depth - 1));
+      as.reload(entry(temps + ins.slot));
+      ++depth;
+      break;
+    case OpCode::Sine:
+      as.call(address(&callSin));
+      break;
+    case OpCode::Cosine:
+      as.call(address(&callCos));
+      break;
+    case OpCode::Tan:
+      as.call(address(&callTan));
+      break;
+    case OpCode::Exp:
+      as.call(address(&callExp));
+      break;
+    case OpCode::Log:
+      as.call(address(&callLog));
+      break;
+    case OpCode::Return:
+      as.epilogue(frame);
+      return true;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+} // namespace
+#endif
+
+bool Tokenizer::JitFunction::isSupported() noexcept {
+#ifdef FNP_JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::unique_ptr<Tokenizer::JitFunction>
+Tokenizer::JitFunction::compile(const Program &program) {
+#ifdef FNP_JIT_X86_64
+  Assembler as{};
+  if (!generate(program, as))
+    return nullptr;
+
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const std::size_t size = (as.code().size() + page - 1) / page * page;
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+
+  std::memcpy(memory, as.code().data(), as.code().size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+  return std::unique_ptr<JitFunction>(new JitFunction(memory, size));
+#else
+  (void)program;
+  return nullptr;
+#endif
+}
+
+Tokenizer::JitFunction::JitFunction(void *memory, std::size_t size) noexcept
+    : m_memory(memory), m_size(size),
+      m_entry(reinterpret_cast<Entry>(memory)) {}
+
+Tokenizer::JitFunction::~JitFunction() {
+#ifdef FNP_JIT_X86_64
+  munmap(m_memory, m_size);
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Bytecode.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace Tokenizer {
+
+/**
+ * @class JitFunction
+ * @brief Native x86-64 code generated from a bytecode `Program`.
+ *
+ * The generated function keeps the top of the value stack in `xmm0`, spills
+ * the rest to its own stack frame and calls libm for the transcendental
+ * functions, so its results match `Program::run()` exactly. Code lives in
+ * an anonymous mapping that is made executable only after it is written.
+ *
+ * The JIT needs an x86-64 System V platform; elsewhere `compile()` always
+ * returns null and callers keep using the interpreter.
+ */
+class JitFunction {
+public:
+  using Entry = double (*)(const double *slots);
+
+  /**
+   * @brief Translates a program to machine code.
+   * @return The compiled function, or null if the platform or one of the
+   * program's instructions is not supported.
+   */
+  static std::unique_ptr<JitFunction> compile(const Program &program);
+
+  /**
+   * @brief Tells whether this build can generate native code at all.
+   */
+  static bool isSupported() noexcept;
+
+  JitFunction(const JitFunction &) = delete;
+  JitFunction &operator=(const JitFunction &) = delete;
+  ~JitFunction();
+
+  /**
+   * @brief Runs the generated code.
+   * @param slots The value of every variable, indexed by slot.
+   */
+  double operator()(const double *slots) const noexcept {
+    return m_entry(slots);
+  }
+
+  std::size_t codeSize() const noexcept { return m_size; }
+
+private:
+  JitFunction(void *memory, std::size_t size) noexcept;
+
+  void *m_memory{};
+  std::size_t m_size{};
+  Entry m_entry{};
+};
+
+} // namespace Tokenizer
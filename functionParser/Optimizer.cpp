@@ -0,0 +1,215 @@
+#include "Optimizer.hpp"
+#include "Types.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+using Tokenizer::OpCode;
+using types::kNoNode;
+using types::Node;
+using types::NodeId;
+
+struct NodeEqual {
+  bool operator()(const Node &a, const Node &b) const noexcept {
+    return a.op == b.op && a.slot == b.slot &&
+           std::memcmp(&a.constant, &b.constant, sizeof a.constant) == 0 &&
+           a.lhs == b.lhs && a.rhs == b.rhs;
+  }
+};
+
+struct NodeHash {
+  std::size_t operator()(const Node &node) const noexcept {
+    std::uint64_t bits{};
+    std::memcpy(&bits, &node.constant, sizeof bits);
+    std::size_t h = std::hash<std::uint64_t>{}(bits);
+    for (std::size_t v : {static_cast<std::size_t>(node.op),
+                          static_cast<std::size_t>(node.slot),
+                          static_cast<std::size_t>(node.lhs),
+                          static_cast<std::size_t>(node.rhs)})
+      h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+/**
+ * Hash-consed expression DAG built from a program's instruction stream.
+ * Structurally identical subexpressions map to the same node, and nodes are
+ * simplified as they are created, so by the time a parent is built its
+ * children are already in their final form.
+ */
+class DagBuilder {
+public:
+  explicit DagBuilder(std::size_t nodes) {
+    m_ast.reserve(nodes);
+    m_index.reserve(nodes);
+  }
+
+  NodeId constant(double value) {
+    return add(Node{OpCode::PushConstant, 0, value, kNoNode, kNoNode});
+  }
+
+  NodeId variable(std::uint32_t slot) {
+    return add(Node{OpCode::PushVariable, slot, 0, kNoNode, kNoNode});
+  }
+
+  NodeId unary(OpCode op, NodeId arg) {
+    if (isConstant(arg))
+      return constant(applyUnary(op, valueOf(arg)));
+    return add(Node{op, 0, 0, arg, kNoNode});
+  }
+
+  NodeId binary(OpCode op, NodeId lhs, NodeId rhs) {
+    if (isConstant(lhs) && isConstant(rhs))
+      return constant(applyBinary(op, valueOf(lhs), valueOf(rhs)));
+
+    // Sums and products commute, so put operands in a canonical order to let
+    // `a*b` and `b*a` share a node.
+    if ((op == OpCode::Sum || op == OpCode::Mult) && lhs > rhs)
+      std::swap(lhs, rhs);
+
+    switch (op) {
+    case OpCode::Sum:
+      if (isConstant(lhs, 0))
+        return rhs;
+      if (isConstant(rhs, 0))
+        return lhs;
+      break;
+    case OpCode::Sub:
+      if (isConstant(rhs, 0))
+        return lhs;
+      break;
+    case OpCode::Mult:
+      if (isConstant(lhs, 1))
+        return rhs;
+      if (isConstant(rhs, 1))
+        return lhs;
+      if (lhs == rhs)
+        return unary(OpCode::Square, lhs);
+      break;
+    case OpCode::Div:
+      if (isConstant(rhs, 1))
+        return lhs;
+      break;
+    case OpCode::Pow:
+      if (isConstant(lhs, 1) || isConstant(rhs, 0))
+        return constant(1);
+      if (isConstant(rhs, 1))
+        return lhs;
+      if (isConstant(rhs, 2))
+        return unary(OpCode::Square, lhs);
+      if (isConstant(rhs, 3))
+        return binary(OpCode::Mult, unary(OpCode::Square, lhs), lhs);
+      if (isConstant(rhs, 4))
+        return unary(OpCode::Square, unary(OpCode::Square, lhs));
+      if (isConstant(rhs, 0.5))
+        return unary(OpCode::Sqrt, lhs);
+      if (isConstant(rhs, -1))
+        return binary(OpCode::Div, constant(1), lhs);
+      break;
+    default:
+      break;
+    }
+    return add(Node{op, 0, 0, lhs, rhs});
+  }
+
+  const types::Ast &ast() const noexcept { return m_ast; }
+
+private:
+  NodeId add(const Node &node) {
+    auto [it, inserted] = m_index.try_emplace(
+        node, static_cast<NodeId>(m_ast.size()));
+    if (inserted)
+      m_ast.add(node);
+    return it->second;
+  }
+
+  bool isConstant(NodeId id) const {
+    return m_ast[id].op == OpCode::PushConstant;
+  }
+  bool isConstant(NodeId id, double value) const {
+    return isConstant(id) && m_ast[id].constant == value;
+  }
+  double valueOf(NodeId id) const { return m_ast[id].constant; }
+
+  static double applyUnary(OpCode op, double a) {
+    switch (op) {
+    case OpCode::Sine:
+      return std::sin(a);
+    case OpCode::Cosine:
+      return std::cos(a);
+    case OpCode::Tan:
+      return std::tan(a);
+    case OpCode::Exp:
+      return std::exp(a);
+    case OpCode::Sqrt:
+      return std::sqrt(a);
+    case OpCode::Log:
+      return std::log(a);
+    case OpCode::Square:
+      return a * a;
+    default:
+      return NAN;
+    }
+  }
+
+  static double applyBinary(OpCode op, double a, double b) {
+    switch (op) {
+    case OpCode::Sum:
+      return a + b;
+    case OpCode::Sub:
+      return a - b;
+    case OpCode::Mult:
+      return a * b;
+    case OpCode::Div:
+      return a / b;
+    case OpCode::Pow:
+      return std::pow(a, b);
+    default:
+      return NAN;
+    }
+  }
+
+  types::Ast m_ast{};
+  std::unordered_map<Node, NodeId, NodeHash, NodeEqual> m_index{};
+};
+} // namespace
+
+Tokenizer::Program Tokenizer::optimize(const Program &program) {
+  DagBuilder dag(program.code().size());
+  std::vector<NodeId> stack{};
+
+  for (const auto &ins : program.code()) {
+    switch (ins.op) {
+    case OpCode::PushConstant:
+      stack.push_back(dag.constant(ins.constant));
+      break;
+    case OpCode::PushVariable:
+      stack.push_back(dag.variable(ins.slot));
+      break;
+    case OpCode::Return:
+      break;
+    case OpCode::StoreTemp:
+    case OpCode::LoadTemp:
+      // Only the optimizer itself emits these; the program is already done.
+      return program;
+    default:
+      if (stackEffect(ins.op).pops == 2) {
+        const NodeId rhs = stack.back();
+        stack.pop_back();
+        stack.back() = dag.binary(ins.op, stack.back(), rhs);
+      } else {
+        stack.back() = dag.unary(ins.op, stack.back());
+      }
+      break;
+    }
+  }
+
+  return Program::assemble(dag.ast().lower(stack.back()),
+                           program.variables());
+}
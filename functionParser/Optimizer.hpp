@@ -0,0 +1,33 @@
+#pragma once
+#include "Bytecode.hpp"
+
+namespace Tokenizer {
+
+/**
+ * @brief Simplifies a program before it is evaluated.
+ *
+ * The program is rebuilt as a hash-consed expression DAG, in which
+ * structurally identical subexpressions are a single node, and rewritten
+ * bottom-up:
+ *  - operations whose operands are all constants are folded,
+ *  - identities such as `x*1`, `1*x`, `x+0`, `x-0`, `x/1` and `x^1` are
+ *    dropped, and `x^0` and `1^x` become 1,
+ *  - small powers are strength-reduced: `x^2`, `x^3` and `x^4` become
+ *    multiplications, `x^0.5` becomes `sqrt(x)` and `x^-1` becomes `1/x`,
+ *  - `e*e` becomes a single squaring of `e`.
+ *
+ * When the code is emitted again, every operation used more than once is
+ * evaluated the first time and reused from a temporary afterwards, so
+ * `sin(x)*sin(x) + sin(x)/x` computes `sin(x)` once per sample (and once per
+ * block in batches).
+ *
+ * Folding uses the same operations as the VM, so folded constants are
+ * exact. Strength-reduced powers may differ from `std::pow` in the last
+ * bit, and `(-0)^0.5` and `(-inf)^0.5` follow `sqrt`.
+ *
+ * @param program A program as produced by `Program::compile()`.
+ * @return An equivalent program that never does more work.
+ */
+Program optimize(const Program &program);
+
+} // namespace Tokenizer
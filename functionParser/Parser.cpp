@@ -0,0 +1,220 @@
+#include "Parser.hpp"
+
+#include <charconv>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+using Tokenizer::Instruction;
+using Tokenizer::Lexeme;
+using Tokenizer::Lexer;
+using Tokenizer::OpCode;
+using Tokenizer::Operator;
+
+/// Deepest nesting of parentheses and right-associative operators.
+constexpr int kMaxNesting = 1024;
+
+constexpr std::pair<std::string_view, Operator> kFunctions[] = {
+    {"sin", Operator::Sine}, {"cos", Operator::Cosine},
+    {"tan", Operator::Tan},  {"exp", Operator::Exp},
+    {"sqrt", Operator::Sqrt}, {"log", Operator::Log},
+};
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+bool isLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+bool isNameChar(char c) { return isLetter(c) || isDigit(c) || c == '_'; }
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+bool isSymbol(const Lexeme &lexeme, char symbol) {
+  return lexeme.kind == Lexeme::Kind::Symbol && lexeme.text[0] == symbol;
+}
+
+class Parser {
+public:
+  explicit Parser(std::string_view source) : m_lexer(source) {
+    // Roughly one instruction per two characters; the exact count does not
+    // matter, it only saves regrowing.
+    m_code.reserve(source.size() / 2 + 1);
+  }
+
+  Tokenizer::Program run() {
+    if (m_lexer.current().kind == Lexeme::Kind::End)
+      throw std::runtime_error("Empty expression");
+    expression(0, 0);
+    const Lexeme &rest = m_lexer.current();
+    if (rest.kind != Lexeme::Kind::End)
+      throw std::runtime_error(fmt::format("Unexpected '{}' at position {}",
+                                           rest.text, rest.position));
+    return Tokenizer::Program::assemble(std::move(m_code),
+                                        std::move(m_variables));
+  }
+
+private:
+  // Parses operands joined by operators binding at least as tightly as
+  // `minPrecedence`.
+  void expression(int minPrecedence, int depth) {
+    if (depth > kMaxNesting)
+      throw std::runtime_error("Expression is nested too deeply");
+    operand(depth);
+    for (;;) {
+      const Lexeme &lexeme = m_lexer.current();
+      if (lexeme.kind != Lexeme::Kind::Symbol)
+        return;
+      const auto op = static_cast<Operator>(lexeme.text[0]);
+      const int precedence = Tokenizer::getOperatorPrecedence(op);
+      if (precedence < 0 || precedence < minPrecedence)
+        return;
+      m_lexer.advance();
+      if (!startsOperand(m_lexer.current()))
+        throw std::runtime_error(
+            fmt::format("Missing operand for '{}'", static_cast<char>(op)));
+      expression(Tokenizer::getAssociativity(op) ==
+                         Tokenizer::Associativity::Right
+                     ? precedence
+                     : precedence + 1,
+                 depth + 1);
+      emit(Tokenizer::opCodeForOperator(op));
+    }
+  }
+
+  static bool startsOperand(const Lexeme &lexeme) {
+    return lexeme.kind == Lexeme::Kind::Number ||
+           lexeme.kind == Lexeme::Kind::Identifier || isSymbol(lexeme, '(');
+  }
+
+  void operand(int depth) {
+    const Lexeme lexeme = m_lexer.current();
+    switch (lexeme.kind) {
+    case Lexeme::Kind::Number: {
+      Instruction ins{OpCode::PushConstant};
+      ins.constant = lexeme.number;
+      m_code.push_back(ins);
+      m_lexer.advance();
+      return;
+    }
+    case Lexeme::Kind::Identifier:
+      m_lexer.advance();
+      if (isSymbol(m_lexer.current(), '(')) {
+        const Operator fn = Tokenizer::functionOperator(lexeme.text);
+        if (fn == Operator::None)
+          throw std::runtime_error(
+              fmt::format("Unknown function: {}", lexeme.text));
+        group(depth);
+        emit(Tokenizer::opCodeForOperator(fn));
+        return;
+      }
+      if (Tokenizer::functionOperator(lexeme.text) != Operator::None)
+        throw std::runtime_error(
+            fmt::format("Missing '(' after {}", lexeme.text));
+      variable(lexeme.text);
+      return;
+    case Lexeme::Kind::Symbol:
+      if (lexeme.text[0] == '(') {
+        group(depth);
+        return;
+      }
+      throw std::runtime_error(fmt::format("Unexpected '{}' at position {}",
+                                           lexeme.text, lexeme.position));
+    case Lexeme::Kind::End:
+      throw std::runtime_error("Unexpected end of expression");
+    }
+  }
+
+  // Parses `( expression )` with the cursor on the opening parenthesis.
+  void group(int depth) {
+    const std::size_t open = m_lexer.current().position;
+    m_lexer.advance();
+    expression(0, depth + 1);
+    if (!isSymbol(m_lexer.current(), ')'))
+      throw std::runtime_error(fmt::format(
+          "Missing ')' for the '(' at position {}", open));
+    m_lexer.advance();
+  }
+
+  void variable(std::string_view name) {
+    std::size_t slot = 0;
+    while (slot < m_variables.size() && m_variables[slot] != name)
+      ++slot;
+    if (slot == m_variables.size())
+      m_variables.emplace_back(name);
+    Instruction ins{OpCode::PushVariable};
+    ins.slot = static_cast<std::uint32_t>(slot);
+    m_code.push_back(ins);
+  }
+
+  void emit(OpCode op) { m_code.push_back(Instruction{op}); }
+
+  Lexer m_lexer;
+  std::vector<Instruction> m_code{};
+  std::vector<std::string> m_variables{};
+};
+} // namespace
+
+Tokenizer::Lexer::Lexer(std::string_view source) : m_source(source) {
+  advance();
+}
+
+void Tokenizer::Lexer::advance() {
+  while (m_pos < m_source.size() && isSpace(m_source[m_pos]))
+    ++m_pos;
+  const std::size_t start = m_pos;
+  m_current = Lexeme{};
+  m_current.position = start;
+  if (start == m_source.size())
+    return;
+
+  const char c = m_source[start];
+  if (isDigit(c) || c == '.') {
+    while (m_pos < m_source.size() &&
+           (isDigit(m_source[m_pos]) || m_source[m_pos] == '.'))
+      ++m_pos;
+    const char *first = m_source.data() + start;
+    const char *last = m_source.data() + m_pos;
+    const auto [end, error] = std::from_chars(first, last, m_current.number,
+                                              std::chars_format::fixed);
+    if (error != std::errc{} || end != last)
+      throw std::runtime_error(
+          fmt::format("Invalid number: {}", std::string_view(first, last)));
+    m_current.kind = Lexeme::Kind::Number;
+  } else if (isLetter(c)) {
+    while (m_pos < m_source.size() && isNameChar(m_source[m_pos]))
+      ++m_pos;
+    m_current.kind = Lexeme::Kind::Identifier;
+  } else {
+    switch (c) {
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+    case '^':
+    case '(':
+    case ')':
+    case ',':
+      ++m_pos;
+      m_current.kind = Lexeme::Kind::Symbol;
+      break;
+    default:
+      throw std::runtime_error(std::string("Unexpected character: ") + c);
+    }
+  }
+  m_current.text = m_source.substr(start, m_pos - start);
+}
+
+auto Tokenizer::functionOperator(std::string_view name) noexcept -> Operator {
+  for (const auto &[fnName, op] : kFunctions)
+    if (fnName == name)
+      return op;
+  return Operator::None;
+}
+
+auto Tokenizer::parse(std::string_view expression) -> Program {
+  return Parser(expression).run();
+}
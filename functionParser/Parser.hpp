@@ -0,0 +1,80 @@
+#pragma once
+#include "Bytecode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Tokenizer {
+
+/**
+ * @struct Lexeme
+ * @brief One token of an expression, as a view into its source.
+ */
+struct Lexeme {
+  enum class Kind : std::uint8_t {
+    Number,     ///< `number` holds its value
+    Identifier, ///< A name: a letter, then letters, digits or `_`
+    Symbol,     ///< One of `+ - * / ^ ( ) ,`
+    End,        ///< Past the last token
+  };
+
+  Kind kind{Kind::End};
+  std::string_view text{};
+  double number{};
+  std::size_t position{}; ///< Offset of `text` in the source
+};
+
+/**
+ * @class Lexer
+ * @brief Splits an expression into lexemes in a single pass.
+ *
+ * Lexemes are views into the source, which must outlive the lexer, and
+ * numbers are converted with `std::from_chars`, so lexing never allocates.
+ */
+class Lexer {
+public:
+  /**
+   * @brief Starts lexing `source` and reads its first lexeme.
+   * @throws std::runtime_error on a character outside the grammar.
+   */
+  explicit Lexer(std::string_view source);
+
+  /// The lexeme under the cursor.
+  const Lexeme &current() const noexcept { return m_current; }
+
+  /**
+   * @brief Moves on to the next lexeme.
+   * @throws std::runtime_error on a character outside the grammar or a
+   * malformed number.
+   */
+  void advance();
+
+private:
+  std::string_view m_source{};
+  std::size_t m_pos{};
+  Lexeme m_current{};
+};
+
+/**
+ * @brief Gets the function operator for a name such as `sin`.
+ * @return The operator, or `Operator::None` if there is no such function.
+ */
+Operator functionOperator(std::string_view name) noexcept;
+
+/**
+ * @brief Parses an infix expression straight into bytecode.
+ *
+ * A precedence-climbing parser over `Lexer` that emits each instruction as
+ * soon as its operands are complete, in the same order as
+ * `Program::compile(shunting_yard(expression))`. The instruction and
+ * variable lists of the result are the only allocations, so the cost is
+ * linear in the length of the expression.
+ *
+ * @param expression The infix expression to parse.
+ * @return The unoptimized program.
+ * @throws std::runtime_error if the expression is malformed.
+ */
+Program parse(std::string_view expression);
+
+} // namespace Tokenizer
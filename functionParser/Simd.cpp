@@ -0,0 +1,133 @@
+#include "Simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FNP_SIMD_X86 1
+#include <immintrin.h>
+#define FNP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+bool Tokenizer::simd::hasAvx2() noexcept {
+#ifdef FNP_SIMD_X86
+  static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+#ifdef FNP_SIMD_X86
+
+// Each kernel comes in an AVX2 (4 lanes) and an SSE2 (2 lanes) flavour with a
+// scalar tail; the public entry point picks one at run time.
+#define FNP_BINARY_KERNEL(name, avx, sse, expr)                                \
+  FNP_TARGET_AVX2 static void name##Avx2(const double *a, const double *b,     \
+                                         double *out, std::size_t n) {         \
+    std::size_t i = 0;                                                         \
+    for (; i + 4 <= n; i += 4)                                                 \
+      _mm256_storeu_pd(out + i,                                                \
+                       avx(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));   \
+    for (; i < n; ++i)                                                         \
+      out[i] = expr;                                                           \
+  }                                                                            \
+  static void name##Sse2(const double *a, const double *b, double *out,        \
+                         std::size_t n) {                                      \
+    std::size_t i = 0;                                                         \
+    for (; i + 2 <= n; i += 2)                                                 \
+      _mm_storeu_pd(out + i, sse(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));   \
+    for (; i < n; ++i)                                                         \
+      out[i] = expr;                                                           \
+  }                                                                            \
+  void Tokenizer::simd::name(const double *a, const double *b, double *out,    \
+                             std::size_t n) noexcept {                         \
+    if (hasAvx2())                                                             \
+      name##Avx2(a, b, out, n);                                                \
+    else                                                                       \
+      name##Sse2(a, b, out, n);                                                \
+  }
+
+FNP_BINARY_KERNEL(add, _mm256_add_pd, _mm_add_pd, a[i] + b[i])
+FNP_BINARY_KERNEL(sub, _mm256_sub_pd, _mm_sub_pd, a[i] - b[i])
+FNP_BINARY_KERNEL(mul, _mm256_mul_pd, _mm_mul_pd, a[i] * b[i])
+FNP_BINARY_KERNEL(div, _mm256_div_pd, _mm_div_pd, a[i] / b[i])
+
+#undef FNP_BINARY_KERNEL
+
+FNP_TARGET_AVX2 static void sqrtAvx2(const double *a, double *out,
+                                     std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(a + i)));
+  for (; i < n; ++i)
+    out[i] = std::sqrt(a[i]);
+}
+
+static void sqrtSse2(const double *a, double *out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_loadu_pd(a + i)));
+  for (; i < n; ++i)
+    out[i] = std::sqrt(a[i]);
+}
+
+void Tokenizer::simd::sqrt(const double *a, double *out,
+                           std::size_t n) noexcept {
+  if (hasAvx2())
+    sqrtAvx2(a, out, n);
+  else
+    sqrtSse2(a, out, n);
+}
+
+#else
+
+#define FNP_BINARY_KERNEL(name, expr)                                          \
+  void Tokenizer::simd::name(const double *a, const double *b, double *out,    \
+                             std::size_t n) noexcept {                         \
+    for (std::size_t i = 0; i < n; ++i)                                        \
+      out[i] = expr;                                                           \
+  }
+
+FNP_BINARY_KERNEL(add, a[i] + b[i])
+FNP_BINARY_KERNEL(sub, a[i] - b[i])
+FNP_BINARY_KERNEL(mul, a[i] * b[i])
+FNP_BINARY_KERNEL(div, a[i] / b[i])
+
+#undef FNP_BINARY_KERNEL
+
+void Tokenizer::simd::sqrt(const double *a, double *out,
+                           std::size_t n) noexcept {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = std::sqrt(a[i]);
+}
+
+#endif
+
+void Tokenizer::simd::pow(const double *a, const double *b, double *out,
+                          std::size_t n) noexcept {
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = std::pow(a[i], b[i]);
+}
+
+#define FNP_LIBM_KERNEL(name)                                                  \
+  void Tokenizer::simd::name(const double *a, double *out,                     \
+                             std::size_t n) noexcept {                         \
+    for (std::size_t i = 0; i < n; ++i)                                        \
+      out[i] = std::name(a[i]);                                                \
+  }
+
+FNP_LIBM_KERNEL(sin)
+FNP_LIBM_KERNEL(cos)
+FNP_LIBM_KERNEL(tan)
+FNP_LIBM_KERNEL(exp)
+FNP_LIBM_KERNEL(log)
+
+#undef FNP_LIBM_KERNEL
+
+void Tokenizer::simd::fill(double value, double *out, std::size_t n) noexcept {
+  std::fill(out, out + n, value);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * @namespace Tokenizer::simd
+ * @brief Array kernels used by the batched evaluator.
+ *
+ * Every kernel applies one operation element-wise over `n` values. The
+ * arithmetic kernels and `sqrt` use AVX2 when the CPU supports it and SSE2
+ * otherwise; the remaining functions run libm over the array so batched
+ * results match the scalar evaluator bit for bit. Outputs may alias inputs.
+ */
+namespace Tokenizer::simd {
+
+void add(const double *a, const double *b, double *out, std::size_t n) noexcept;
+void sub(const double *a, const double *b, double *out, std::size_t n) noexcept;
+void mul(const double *a, const double *b, double *out, std::size_t n) noexcept;
+void div(const double *a, const double *b, double *out, std::size_t n) noexcept;
+void pow(const double *a, const double *b, double *out, std::size_t n) noexcept;
+
+void sqrt(const double *a, double *out, std::size_t n) noexcept;
+void sin(const double *a, double *out, std::size_t n) noexcept;
+void cos(const double *a, double *out, std::size_t n) noexcept;
+void tan(const double *a, double *out, std::size_t n) noexcept;
+void exp(const double *a, double *out, std::size_t n) noexcept;
+void log(const double *a, double *out, std::size_t n) noexcept;
+
+/**
+ * @brief Sets every element of `out` to `value`.
+ */
+void fill(double value, double *out, std::size_t n) noexcept;
+
+/**
+ * @brief Tells whether the AVX2 code paths are in use on this machine.
+ */
+bool hasAvx2() noexcept;
+
+} // namespace Tokenizer::simd
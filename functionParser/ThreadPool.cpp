@@ -0,0 +1,147 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace {
+thread_local bool t_inPool = false;
+
+std::mutex g_sharedMutex{};
+std::unique_ptr<Tokenizer::ThreadPool> g_shared{};
+std::size_t g_sharedThreads = 0;
+} // namespace
+
+Tokenizer::ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < threads; ++i)
+    m_queues.push_back(std::make_unique<Queue>());
+  // Queue 0 belongs to whichever thread calls parallelFor().
+  for (std::size_t i = 1; i < threads; ++i)
+    m_workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+Tokenizer::ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &worker : m_workers)
+    worker.join();
+}
+
+void Tokenizer::ThreadPool::parallelFor(std::size_t count, std::size_t grain,
+                                        const Body &body) {
+  if (count == 0)
+    return;
+  grain = std::max<std::size_t>(grain, 1);
+
+  const std::size_t chunks = (count + grain - 1) / grain;
+  if (threadCount() == 1 || chunks == 1 || t_inPool) {
+    body(0, count);
+    return;
+  }
+
+  std::lock_guard submit(m_submit);
+  m_body = &body;
+  m_error = nullptr;
+  m_pending.store(chunks, std::memory_order_relaxed);
+
+  // Hand every thread a contiguous run of chunks so each mostly touches its
+  // own stretch of the output.
+  const std::size_t threads = threadCount();
+  for (std::size_t t = 0; t < threads; ++t) {
+    std::lock_guard lock(m_queues[t]->mutex);
+    for (std::size_t c = t * chunks / threads; c < (t + 1) * chunks / threads;
+         ++c)
+      m_queues[t]->ranges.push_back(
+          {c * grain, std::min(count, (c + 1) * grain)});
+  }
+  {
+    std::lock_guard lock(m_mutex);
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  t_inPool = true;
+  runChunks(0);
+  t_inPool = false;
+
+  for (auto left = m_pending.load(std::memory_order_acquire); left != 0;
+       left = m_pending.load(std::memory_order_acquire))
+    m_pending.wait(left, std::memory_order_acquire);
+
+  m_body = nullptr;
+  if (m_error)
+    std::rethrow_exception(m_error);
+}
+
+void Tokenizer::ThreadPool::workerLoop(std::size_t self) {
+  t_inPool = true;
+  std::size_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+      if (m_stop)
+        return;
+      seen = m_generation;
+    }
+    runChunks(self);
+  }
+}
+
+void Tokenizer::ThreadPool::runChunks(std::size_t self) {
+  Range range{};
+  while (take(self, range)) {
+    try {
+      (*m_body)(range.begin, range.end);
+    } catch (...) {
+      std::lock_guard lock(m_errorMutex);
+      if (!m_error)
+        m_error = std::current_exception();
+    }
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      m_pending.notify_all();
+  }
+}
+
+bool Tokenizer::ThreadPool::take(std::size_t self, Range &range) {
+  {
+    Queue &own = *m_queues[self];
+    std::lock_guard lock(own.mutex);
+    if (!own.ranges.empty()) {
+      range = own.ranges.front();
+      own.ranges.pop_front();
+      return true;
+    }
+  }
+  // Steal from the far end of the other queues, starting with the next
+  // thread so thieves spread out.
+  const std::size_t threads = threadCount();
+  for (std::size_t i = 1; i < threads; ++i) {
+    Queue &victim = *m_queues[(self + i) % threads];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.ranges.empty()) {
+      range = victim.ranges.back();
+      victim.ranges.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+Tokenizer::ThreadPool &Tokenizer::ThreadPool::shared() {
+  std::lock_guard lock(g_sharedMutex);
+  if (!g_shared)
+    g_shared = std::make_unique<ThreadPool>(g_sharedThreads);
+  return *g_shared;
+}
+
+void Tokenizer::ThreadPool::setSharedThreadCount(std::size_t threads) {
+  std::lock_guard lock(g_sharedMutex);
+  g_sharedThreads = threads;
+  if (g_shared && g_shared->threadCount() != threads)
+    g_shared.reset();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tokenizer {
+
+/**
+ * @class ThreadPool
+ * @brief Persistent workers that split index ranges by work stealing.
+ *
+ * `parallelFor()` cuts a range into chunks and deals them out in contiguous
+ * runs, one run per thread. Each thread takes chunks from the front of its
+ * own queue and, once that is empty, steals from the back of another's, so
+ * uneven chunks (a pole, a steep stretch) do not leave threads idle. The
+ * calling thread works alongside the pool, and a pool of one thread runs
+ * everything inline, in order.
+ */
+class ThreadPool {
+public:
+  /// Doubles per cache line. Splitting an array of doubles at multiples of
+  /// it keeps neighbouring chunks from writing to the same line.
+  static constexpr std::size_t kCacheLineDoubles = 64 / sizeof(double);
+
+  /// Called with a half-open index range [begin, end).
+  using Body = std::function<void(std::size_t, std::size_t)>;
+
+  /**
+   * @brief Starts the workers.
+   * @param threads Threads to run on, including the caller; 0 picks the
+   * hardware concurrency.
+   */
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /// Threads `parallelFor()` runs on, including the caller.
+  std::size_t threadCount() const noexcept { return m_queues.size(); }
+
+  /**
+   * @brief Runs `body` over [0, count) in chunks of `grain` indices.
+   *
+   * Returns once every chunk has run. Calls made from inside a chunk run
+   * inline on that thread. If a chunk throws, the remaining chunks still
+   * run and the first exception is rethrown here.
+   */
+  void parallelFor(std::size_t count, std::size_t grain, const Body &body);
+
+  /**
+   * @brief The pool shared by the grapher.
+   *
+   * Created on first use with the count last given to
+   * `setSharedThreadCount()`.
+   */
+  static ThreadPool &shared();
+
+  /**
+   * @brief Sets the size of the shared pool; 1 makes every run serial and
+   * deterministic. Must not be called while the shared pool is busy.
+   */
+  static void setSharedThreadCount(std::size_t threads);
+
+private:
+  struct Range {
+    std::size_t begin{};
+    std::size_t end{};
+  };
+
+  struct alignas(64) Queue {
+    std::mutex mutex{};
+    std::deque<Range> ranges{};
+  };
+
+  void workerLoop(std::size_t self);
+  void runChunks(std::size_t self);
+  bool take(std::size_t self, Range &range);
+
+  std::vector<std::unique_ptr<Queue>> m_queues{};
+  std::vector<std::thread> m_workers{};
+
+  std::mutex m_submit{}; ///< One parallelFor() at a time
+  std::mutex m_mutex{};
+  std::condition_variable m_wake{};
+  std::size_t m_generation{};
+  bool m_stop{};
+
+  const Body *m_body{};
+  std::atomic<std::size_t> m_pending{};
+  std::mutex m_errorMutex{};
+  std::exception_ptr m_error{};
+};
+
+} // namespace Tokenizer
@@ -1,6 +1,6 @@
 #include "Tokenizer.hpp"
 #include "Logger.hpp"
-#include <SFML/Graphics/VertexArray.hpp>
+#include "Parser.hpp"
 #include <algorithm>
 #include <cctype>
 #include <fmt/base.h>
@@ -92,6 +92,7 @@ bool Tokenizer::isFuncOperator(const Tokenizer::TokenType tok) {
     case Operator::Tan:
     case Operator::Exp:
     case Operator::Sqrt:
+    case Operator::Log:
       return true;
     case Operator::None:
     default:
@@ -114,6 +115,8 @@ auto Tokenizer::getFuncForOperator(const Tokenizer::Operator tok)
     return UnaryFunction{"exp", [](double x) { return std::exp(x); }};
   case Operator::Sqrt:
     return UnaryFunction{"sqrt", [](double x) { return std::sqrt(x); }};
+  case Operator::Log:
+    return UnaryFunction{"log", [](double x) { return std::log(x); }};
   default:
     throw std::runtime_error("Invalid operator");
   }
@@ -137,85 +140,40 @@ Tokenizer::getAssociativity(const Tokenizer::Operator &op) {
 auto Tokenizer::tokenize(const std::string_view expression)
     -> std::vector<TokenType> {
   std::vector<TokenType> vec{};
-  std::ostringstream oss{};
-
-  for (size_t pos = 0; pos < expression.size(); ++pos) {
-    char curr = expression[pos];
-
-    if (isdigit(curr) || curr == '.') {
-      oss << curr;
-    } else if (std::isalpha(curr)) {
-      std::string function_name;
-      size_t function_start = pos;
-
-      // Check if it's a function call
-      while (pos < expression.size() && std::isalpha(expression[pos])) {
-        function_name += expression[pos];
-        ++pos;
-      }
-
-      if (pos < expression.size() && expression[pos] == '(') {
-        // It's a function call
-        Operator func_op;
-        if (function_name == "sin")
-          func_op = Operator::Sine;
-        else if (function_name == "cos")
-          func_op = Operator::Cosine;
-        else if (function_name == "tan")
-          func_op = Operator::Tan;
-        else if (function_name == "exp")
-          func_op = Operator::Exp;
-        else if (function_name == "sqrt")
-          func_op = Operator::Sqrt;
-        else
-          throw std::runtime_error("Unknown function: " + function_name);
-
+  vec.reserve(expression.size());
+
+  Lexer lexer(expression);
+  for (;;) {
+    const Lexeme lexeme = lexer.current();
+    switch (lexeme.kind) {
+    case Lexeme::Kind::Number:
+      vec.emplace_back(lexeme.number);
+      break;
+    case Lexeme::Kind::Identifier:
+      lexer.advance();
+      if (lexer.current().kind == Lexeme::Kind::Symbol &&
+          lexer.current().text[0] == '(') {
+        // A function call; the argument list follows as ordinary tokens.
+        const Operator func_op = functionOperator(lexeme.text);
+        if (func_op == Operator::None)
+          throw std::runtime_error("Unknown function: " +
+                                   std::string(lexeme.text));
         vec.emplace_back(func_op);
-        vec.emplace_back(Operator::LParen);
-
-        // Find matching closing parenthesis
-        int paren_count = 1;
-        size_t close_paren_pos = pos + 1;
-        while (close_paren_pos < expression.size() && paren_count > 0) {
-          if (expression[close_paren_pos] == '(')
-            ++paren_count;
-          if (expression[close_paren_pos] == ')')
-            --paren_count;
-          ++close_paren_pos;
-        }
-
-        if (paren_count != 0) {
-          throw std::runtime_error("Mismatched parentheses in function call");
-        }
-
-        // Recursively tokenize function arguments
-        auto inner_tokens =
-            tokenize(expression.substr(pos + 1, close_paren_pos - pos - 2));
-        vec.insert(vec.end(), inner_tokens.begin(), inner_tokens.end());
-
-        vec.emplace_back(Operator::RParen);
-        pos = close_paren_pos - 1;
+      } else if (functionOperator(lexeme.text) != Operator::None) {
+        throw std::runtime_error("Missing '(' after " +
+                                 std::string(lexeme.text));
       } else {
-        // It's a variable
-        vec.emplace_back(Variable{function_name[0], 0.0});
-        pos = function_start;
+        vec.emplace_back(Variable{std::string(lexeme.text), 0.0});
       }
-    } else if (isOperator(static_cast<Operator>(curr))) {
-      if (!oss.str().empty()) {
-        vec.emplace_back(std::stod(oss.str()));
-        oss.str("");
-      }
-      vec.emplace_back(static_cast<Operator>(curr));
-    } else if (!std::isspace(curr)) {
-      throw std::runtime_error(std::string("Unexpected character: ") + curr);
+      continue;
+    case Lexeme::Kind::Symbol:
+      vec.emplace_back(static_cast<Operator>(lexeme.text[0]));
+      break;
+    case Lexeme::Kind::End:
+      return vec;
     }
+    lexer.advance();
   }
-
-  if (!oss.str().empty()) {
-    vec.emplace_back(std::stod(oss.str()));
-  }
-
-  return vec;
 }
 class MissingMatchingParenException : public std::exception {
 private:
@@ -286,20 +244,10 @@ Tokenizer::shunting_yard(const std::string &expression) {
     } else if (isVariable(token)) {
       output_queue.emplace_back(token);
       oss << std::get<Variable>(token);
-    } else if (isFunction(token)) {
-      auto fn = std::get<UnaryFunction>(token);
-      if (fn.name == "sin") {
-        op_stack.emplace(Operator::Sine);
-      } else if (fn.name == "cos") {
-        op_stack.emplace(Operator::Cosine);
-      } else if (fn.name == "tan") {
-        op_stack.emplace(Operator::Tan);
-      } else if (fn.name == "sqrt") {
-        op_stack.emplace(Operator::Sqrt);
-      } else if (fn.name == "exp") {
-        op_stack.emplace(Operator::Exp);
-      }
-      continue;
+    } else if (isFuncOperator(token)) {
+      // The argument list follows immediately; the function is emitted once
+      // its closing parenthesis is reached.
+      op_stack.emplace(std::get<Operator>(token));
     } else if (isOperator(token)) {
       auto op = std::get<Operator>(token);
       if (isOperatorButNotAParen(op)) {
@@ -329,6 +277,11 @@ Tokenizer::shunting_yard(const std::string &expression) {
           }
           assert(op_stack.top() == Operator::LParen);
           op_stack.pop();
+          if (not op_stack.empty() and isFuncOperator(op_stack.top())) {
+            output_queue.emplace_back(op_stack.top());
+            oss << static_cast<char>(op_stack.top());
+            op_stack.pop();
+          }
         }
       }
     }
@@ -343,3 +296,98 @@ Tokenizer::shunting_yard(const std::string &expression) {
   Logger::log(fmt::format("Output Queue: {}", oss.str()), LogLevel::kInfo);
   return output_queue;
 }
+
+double Tokenizer::interpret(std::vector<TokenType> rpn,
+                            const std::unordered_map<std::string, double> &var_values) {
+  auto &vec = rpn;
+  if (var_values.empty()) {
+    for (auto &token : vec) {
+      if (isVariable(token)) {
+        std::get<Variable>(token).value = 0;
+      }
+    }
+  } else {
+
+    for (auto &token : vec) {
+      if (isVariable(token)) {
+        if (var_values.find(std::get<Variable>(token).name) ==
+            var_values.end()) {
+          std::get<Variable>(token).value = 0;
+        } else {
+          std::get<Variable>(token).value =
+              var_values.at(std::get<Variable>(token).name);
+        }
+      }
+    }
+  }
+  std::stack<double> accumulator{};
+
+  for (const auto &tok : vec) {
+    if (isNumber(tok)) {
+      accumulator.emplace(std::get<double>(tok));
+    } else if (isVariable(tok)) {
+      accumulator.emplace(std::get<Variable>(tok).value);
+    } else if (isFuncOperator(tok)) {
+      auto op = std::get<Operator>(tok);
+      double argument = accumulator.top();
+      accumulator.pop();
+      auto fn = getFuncForOperator(op);
+      accumulator.emplace(fn.fn(argument));
+    } else if (isOperator(tok)) {
+      auto op = std::get<Operator>(tok);
+
+      double lhs{}, rhs{};
+      switch (op) {
+      case Operator::Sum:
+        lhs = {accumulator.top()};
+        accumulator.pop();
+        rhs = {accumulator.top()};
+        accumulator.pop();
+        Logger::log(
+            fmt::format("Performing operation {} on {} and {}", '+', lhs, rhs));
+        accumulator.emplace(rhs + lhs);
+        break;
+      case Operator::Sub:
+        lhs = {accumulator.top()};
+        accumulator.pop();
+        rhs = {accumulator.top()};
+        accumulator.pop();
+        Logger::log(
+            fmt::format("Performing operation {} on {} and {}", '-', lhs, rhs));
+        accumulator.emplace(rhs - lhs);
+        break;
+      case Operator::Div:
+        lhs = {accumulator.top()};
+        accumulator.pop();
+        rhs = {accumulator.top()};
+        accumulator.pop();
+        Logger::log(
+            fmt::format("Performing operation {} on {} and {}", '/', lhs, rhs));
+        accumulator.emplace(rhs / lhs);
+        break;
+      case Operator::Mult:
+        lhs = {accumulator.top()};
+        accumulator.pop();
+        rhs = {accumulator.top()};
+        accumulator.pop();
+        Logger::log(
+            fmt::format("Performing operation {} on {} and {}", '*', lhs, rhs));
+        accumulator.emplace(rhs * lhs);
+        break;
+      case Operator::Pow:
+        lhs = {accumulator.top()};
+        accumulator.pop();
+        rhs = {accumulator.top()};
+        accumulator.pop();
+        accumulator.emplace(std::pow(rhs, lhs));
+        break;
+      default:
+        return 0;
+      }
+
+    } else {
+    }
+  }
+
+  return accumulator.top();
+}
@@ -8,8 +8,10 @@
 #include <functional>
 #include <iostream>
 #include <queue>
+#include <span>
 #include <sstream>
 #include <stack>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
@@ -47,7 +49,8 @@ enum class Operator : char {
   Cosine = 'c', ///< Cosine function
   Tan = 't',    ///< Tangent function
   Exp = 'e',    ///< Exponential function
-  Sqrt = 'r',
+  Sqrt = 'r',   ///< Square root function
+  Log = 'l',    ///< Natural logarithm function
   None = '\0' ///< No operator
 };
 
@@ -103,8 +106,8 @@ struct OperatorInfo {
  * This structure captures the name and value of a variable.
  */
 struct Variable {
-  char name{};    ///< Name of the variable
-  double value{}; ///< Value of the variable
+  std::string name{}; ///< Name of the variable, e.g. `x` or `alpha`
+  double value{};     ///< Value of the variable
 };
 
 /**
@@ -300,6 +303,28 @@ inline std::string tokenToString(const TokenType &token);
  */
 std::vector<TokenType> shunting_yard(const std::string &expression);
 
+/**
+ * @brief Interprets an RPN token sequence directly.
+ *
+ * This is the original token-walking evaluator. It is kept as a reference
+ * for checking and benchmarking the bytecode VM.
+ *
+ * @param rpn Tokens as produced by `shunting_yard()`.
+ * @param var_values Values of the variables; missing ones are 0.
+ * @return The value of the expression.
+ */
+double interpret(std::vector<TokenType> rpn,
+                 const std::unordered_map<std::string, double> &var_values = {});
+
+/**
+ * @brief Compiles an expression to bytecode and runs it once.
+ * @param expression The expression to evaluate.
+ * @param var_values Values of the variables; missing ones are 0.
+ * @return The value of the expression.
+ */
+double execute(const std::string &expression,
+               const std::unordered_map<std::string, double> &var_values = {});
+
 /**
  * @brief Evaluates a mathematical expression given as a string.
  * @param expression The expression to evaluate.
@@ -308,105 +333,31 @@ std::vector<TokenType> shunting_yard(const std::string &expression);
 
 template <class Output>
 Output evaluate(const std::string &expression,
-                const std::unordered_map<char, double> &var_values = {}) {
+                const std::unordered_map<std::string, double> &var_values = {}) {
 
   static_assert(std::is_arithmetic<Output>::value, "Output must be arithmetic");
 
-  auto vec = shunting_yard(expression);
-  if (var_values.empty()) {
-    for (auto &token : vec) {
-      if (isVariable(token)) {
-        std::get<Variable>(token).value = 0;
-      }
-    }
-  } else {
-
-    for (auto &token : vec) {
-      if (isVariable(token)) {
-        if (var_values.find(std::get<Variable>(token).name) ==
-            var_values.end()) {
-          std::get<Variable>(token).value = 0;
-        } else {
-          std::get<Variable>(token).value =
-              var_values.at(std::get<Variable>(token).name);
-        }
-      }
-    }
-  }
-  std::stack<double> accumulator{};
-
-  for (const auto &tok : vec) {
-    if (isNumber(tok)) {
-      accumulator.emplace(std::get<double>(tok));
-    } else if (isVariable(tok)) {
-      accumulator.emplace(std::get<Variable>(tok).value);
-    } else if (isFuncOperator(tok)) {
-      auto op = std::get<Operator>(tok);
-      double argument = accumulator.top();
-      accumulator.pop();
-      auto fn = getFuncForOperator(op);
-      accumulator.emplace(fn.fn(argument));
-    } else if (isOperator(tok)) {
-      auto op = std::get<Operator>(tok);
-
-      double lhs{}, rhs{};
-      switch (op) {
-      case Operator::Sum:
-        lhs = {accumulator.top()};
-        accumulator.pop();
-        rhs = {accumulator.top()};
-        accumulator.pop();
-        Logger::log(
-            fmt::format("Performing operation {} on {} and {}", '+', lhs, rhs));
-        accumulator.emplace(rhs + lhs);
-        break;
-      case Operator::Sub:
-        lhs = {accumulator.top()};
-        accumulator.pop();
-        rhs = {accumulator.top()};
-        accumulator.pop();
-        Logger::log(
-            fmt::format("Performing operation {} on {} and {}", '-', lhs, rhs));
-        accumulator.emplace(rhs - lhs);
-        break;
-      case Operator::Div:
-        lhs = {accumulator.top()};
-        accumulator.pop();
-        rhs = {accumulator.top()};
-        accumulator.pop();
-        Logger::log(
-            fmt::format("Performing operation {} on {} and {}", '/', lhs, rhs));
-        accumulator.emplace(rhs / lhs);
-        break;
-      case Operator::Mult:
-        lhs = {accumulator.top()};
-        accumulator.pop();
-        rhs = {accumulator.top()};
-        accumulator.pop();
-        Logger::log(
-            fmt::format("Performing operation {} on {} and {}", '*', lhs, rhs));
-        accumulator.emplace(rhs * lhs);
-        break;
-      case Operator::Pow:
-        lhs = {accumulator.top()};
-        accumulator.pop();
-        rhs = {accumulator.top()};
-        accumulator.pop();
-        accumulator.emplace(std::pow(rhs, lhs));
-        break;
-      default:
-        return 0;
-      }
-
-    } else {
-    }
-  }
-
+  double result = execute(expression, var_values);
   return (std::is_integral<Output>::value)
-             ? static_cast<Output>(std::ceil(accumulator.top()))
-             : static_cast<Output>(accumulator.top());
+             ? static_cast<Output>(std::ceil(result))
+             : static_cast<Output>(result);
 }
 
+/**
+ * @brief Evaluates a mathematical expression for a whole array of x values.
+ *
+ * The expression is compiled once and every RPN operation runs as a SIMD
+ * kernel over the inputs, instead of interpreting the program per value.
+ *
+ * @param expression The expression to evaluate.
+ * @param xs The values bound to `x`.
+ * @param out Receives the result for each value of `xs`.
+ * @param var_values Values of the other variables; missing ones are 0.
+ */
+void evaluateBatch(const std::string &expression, std::span<const double> xs,
+                   std::span<double> out,
+                   const std::unordered_map<std::string, double> &var_values = {});
+
 std::vector<std::pair<double, double>> getAllPoints(int max_y);
 
 } // namespace Tokenizer
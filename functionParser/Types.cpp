@@ -0,0 +1,249 @@
+#include "Types.hpp"
+
+#include <cmath>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+using Tokenizer::Instruction;
+using Tokenizer::OpCode;
+using types::kNoNode;
+using types::Node;
+using types::NodeId;
+
+bool isLeaf(const Node &node) {
+  return node.op == OpCode::PushConstant || node.op == OpCode::PushVariable;
+}
+
+const char *functionName(OpCode op) {
+  switch (op) {
+  case OpCode::Sine:
+    return "sin";
+  case OpCode::Cosine:
+    return "cos";
+  case OpCode::Tan:
+    return "tan";
+  case OpCode::Exp:
+    return "exp";
+  case OpCode::Sqrt:
+    return "sqrt";
+  case OpCode::Log:
+    return "log";
+  default:
+    return nullptr;
+  }
+}
+
+char operatorSign(OpCode op) {
+  switch (op) {
+  case OpCode::Sum:
+    return '+';
+  case OpCode::Sub:
+    return '-';
+  case OpCode::Mult:
+    return '*';
+  case OpCode::Div:
+    return '/';
+  default:
+    return '^';
+  }
+}
+
+// Postorder emission with temporaries for shared nodes, the counterpart of
+// `Ast::append()`.
+class Lowering {
+public:
+  explicit Lowering(const std::vector<Node> &nodes)
+      : m_nodes(nodes), m_uses(nodes.size(), 0),
+        m_temps(nodes.size(), kNoNode) {}
+
+  std::vector<Instruction> run(NodeId root) {
+    countUses(root);
+    emit(root);
+    return std::move(m_code);
+  }
+
+private:
+  void countUses(NodeId id) {
+    const Node &node = m_nodes[id];
+    if (m_uses[id]++ > 0 || isLeaf(node))
+      return;
+    countUses(node.lhs);
+    if (node.rhs != kNoNode)
+      countUses(node.rhs);
+  }
+
+  void emit(NodeId id) {
+    const Node &node = m_nodes[id];
+    if (isLeaf(node)) {
+      m_code.push_back(Instruction{node.op, node.slot, node.constant});
+      return;
+    }
+    if (m_temps[id] != kNoNode) {
+      m_code.push_back(Instruction{OpCode::LoadTemp, m_temps[id]});
+      return;
+    }
+
+    emit(node.lhs);
+    if (node.rhs != kNoNode)
+      emit(node.rhs);
+    m_code.push_back(Instruction{node.op});
+    if (m_uses[id] > 1) {
+      m_temps[id] = m_tempCount++;
+      m_code.push_back(Instruction{OpCode::StoreTemp, m_temps[id]});
+    }
+  }
+
+  const std::vector<Node> &m_nodes;
+  std::vector<std::uint32_t> m_uses;
+  std::vector<std::uint32_t> m_temps;
+  std::uint32_t m_tempCount{};
+  std::vector<Instruction> m_code{};
+};
+} // namespace
+
+auto types::Ast::constant(double value) -> NodeId {
+  return add(Node{OpCode::PushConstant, 0, value, kNoNode, kNoNode});
+}
+
+auto types::Ast::variable(std::uint32_t slot) -> NodeId {
+  return add(Node{OpCode::PushVariable, slot, 0, kNoNode, kNoNode});
+}
+
+auto types::Ast::unary(OpCode op, NodeId arg) -> NodeId {
+  return add(Node{op, 0, 0, arg, kNoNode});
+}
+
+auto types::Ast::binary(OpCode op, NodeId lhs, NodeId rhs) -> NodeId {
+  return add(Node{op, 0, 0, lhs, rhs});
+}
+
+auto types::Ast::add(const Node &node) -> NodeId {
+  const auto size = m_nodes.size();
+  if (size >= kNoNode)
+    throw std::length_error("Expression has too many nodes");
+  if (!isLeaf(node) &&
+      (node.lhs >= size || (node.rhs != kNoNode && node.rhs >= size)))
+    throw std::invalid_argument("Operand must precede its operation");
+  m_nodes.push_back(node);
+  return static_cast<NodeId>(size);
+}
+
+auto types::Ast::append(const Tokenizer::Program &program) -> NodeId {
+  std::vector<NodeId> stack{};
+  std::vector<NodeId> temps(program.tempCount(), kNoNode);
+  stack.reserve(program.maxDepth());
+  m_nodes.reserve(m_nodes.size() + program.code().size());
+
+  for (const auto &ins : program.code()) {
+    switch (ins.op) {
+    case OpCode::PushConstant:
+      stack.push_back(constant(ins.constant));
+      break;
+    case OpCode::PushVariable:
+      stack.push_back(variable(ins.slot));
+      break;
+    case OpCode::StoreTemp:
+      temps[ins.slot] = stack.back();
+      break;
+    case OpCode::LoadTemp:
+      stack.push_back(temps[ins.slot]);
+      break;
+    case OpCode::Return:
+      break;
+    default:
+      if (Tokenizer::stackEffect(ins.op).pops == 2) {
+        const NodeId rhs = stack.back();
+        stack.pop_back();
+        stack.back() = binary(ins.op, stack.back(), rhs);
+      } else {
+        stack.back() = unary(ins.op, stack.back());
+      }
+      break;
+    }
+  }
+  return stack.back();
+}
+
+double types::Ast::eval(NodeId root, const double *slots,
+                        std::vector<double> &values) const {
+  values.resize(root + 1);
+  for (NodeId id = 0; id <= root; ++id) {
+    const Node &node = m_nodes[id];
+    const double a = isLeaf(node) ? 0 : values[node.lhs];
+    const double b = node.rhs == kNoNode ? 0 : values[node.rhs];
+    double &out = values[id];
+    switch (node.op) {
+    case OpCode::PushConstant:
+      out = node.constant;
+      break;
+    case OpCode::PushVariable:
+      out = slots[node.slot];
+      break;
+    case OpCode::Sum:
+      out = a + b;
+      break;
+    case OpCode::Sub:
+      out = a - b;
+      break;
+    case OpCode::Mult:
+      out = a * b;
+      break;
+    case OpCode::Div:
+      out = a / b;
+      break;
+    case OpCode::Pow:
+      out = std::pow(a, b);
+      break;
+    case OpCode::Sine:
+      out = std::sin(a);
+      break;
+    case OpCode::Cosine:
+      out = std::cos(a);
+      break;
+    case OpCode::Tan:
+      out = std::tan(a);
+      break;
+    case OpCode::Exp:
+      out = std::exp(a);
+      break;
+    case OpCode::Sqrt:
+      out = std::sqrt(a);
+      break;
+    case OpCode::Log:
+      out = std::log(a);
+      break;
+    case OpCode::Square:
+      out = a * a;
+      break;
+    default:
+      out = NAN;
+      break;
+    }
+  }
+  return values[root];
+}
+
+auto types::Ast::lower(NodeId root) const -> std::vector<Instruction> {
+  return Lowering(m_nodes).run(root);
+}
+
+std::string types::Ast::format(NodeId root,
+                               const std::vector<std::string> &variables) const {
+  const Node &node = m_nodes[root];
+  switch (node.op) {
+  case OpCode::PushConstant:
+    return fmt::format("{}", node.constant);
+  case OpCode::PushVariable:
+    return variables.at(node.slot);
+  case OpCode::Square:
+    return fmt::format("({})^2", format(node.lhs, variables));
+  default:
+    break;
+  }
+  if (const char *name = functionName(node.op))
+    return fmt::format("{}({})", name, format(node.lhs, variables));
+  return fmt::format("({} {} {})", format(node.lhs, variables),
+                     operatorSign(node.op), format(node.rhs, variables));
+}
@@ -1,96 +1,113 @@
 #pragma once
-#define FNP_CST_NOEX const noexcept
-#include <fmt/core.h>
+#include "Bytecode.hpp"
 
-#include <cassert>
-#include <cmath>
-#include <cstdio>
-#include <functional>
-#include <iostream>
-#include <variant>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace types {
-class TreeNode {
- public:
-  virtual void print() FNP_CST_NOEX = 0;
-  virtual double eval() FNP_CST_NOEX = 0;
-  virtual ~TreeNode() = default;  // Ensure proper cleanup
-};
 
-struct InfixOperator : public TreeNode {
-  TreeNode *left{};
-  TreeNode *right{};
-};
+/// Index of a node in an `Ast`.
+using NodeId = std::uint32_t;
+/// Stands for a missing operand.
+inline constexpr NodeId kNoNode = std::numeric_limits<NodeId>::max();
 
-class PrefixUnaryOperator : public TreeNode {
- public:
-  TreeNode *arg;
+/**
+ * @struct Node
+ * @brief One operation of an expression tree.
+ *
+ * A plain record: leaves hold their constant or variable slot, and
+ * operations refer to their operands by index. Unary operations leave `rhs`
+ * at `kNoNode`.
+ */
+struct Node {
+  Tokenizer::OpCode op; ///< PushConstant, PushVariable or an operation
+  std::uint32_t slot;   ///< Variable slot for PushVariable
+  double constant;      ///< Value for PushConstant
+  NodeId lhs;           ///< First operand, or `kNoNode` for leaves
+  NodeId rhs;           ///< Second operand, or `kNoNode`
 };
+static_assert(std::is_trivially_copyable_v<Node>);
+static_assert(sizeof(Node) == 24, "Nodes should stay compact");
 
-class ValueNode : public TreeNode {
- public:
-  double value{};
-  ValueNode(double value) : value(value) {}
-  virtual void print() FNP_CST_NOEX override { fmt::print("{}", value); }
-  virtual double eval() FNP_CST_NOEX override { return value; }
-};
-
-struct BinaryOperation_t {
-  char sign{};
-  std::function<double(double, double)> operation{};
-};
+/**
+ * @class Ast
+ * @brief An arena of expression nodes addressed by index.
+ *
+ * Nodes live in one contiguous vector and are released together by
+ * `clear()` or the destructor; nothing points into the arena, so it can grow
+ * and be copied freely. An operand always precedes the operations that use
+ * it, which makes index order a valid evaluation order: walks are linear
+ * sweeps over memory with no recursion and no virtual dispatch.
+ *
+ * A node may be the operand of several others, so an arena can hold a DAG
+ * with shared subexpressions as well as a tree.
+ */
+class Ast {
+public:
+  /// Adds a constant leaf.
+  NodeId constant(double value);
+  /// Adds a leaf reading variable `slot`.
+  NodeId variable(std::uint32_t slot);
+  /// Adds a unary operation such as `Sine` or `Square`.
+  NodeId unary(Tokenizer::OpCode op, NodeId arg);
+  /// Adds a binary operation such as `Sum` or `Pow`.
+  NodeId binary(Tokenizer::OpCode op, NodeId lhs, NodeId rhs);
 
-class BinaryOperator : public InfixOperator {
- protected:
-  BinaryOperation_t p_operation{};
-  BinaryOperator(const BinaryOperation_t &bin) : p_operation(bin) {}
+  /**
+   * @brief Adds a node as it is.
+   * @throws std::invalid_argument if an operand is not already in the arena.
+   * @throws std::length_error if the arena is out of indices.
+   */
+  NodeId add(const Node &node);
 
- public:
-  virtual void print() FNP_CST_NOEX override {
-    if (!left || !right) {
-      fmt::print("null.");
-      return;
-    }
-    fmt::print("({} {} {})", left->eval(), p_operation.sign, right->eval());
-  }
+  /**
+   * @brief Rebuilds the expression computed by a program.
+   *
+   * Values kept in temporaries become shared nodes.
+   *
+   * @return The root of the expression.
+   */
+  NodeId append(const Tokenizer::Program &program);
 
-  virtual double eval() FNP_CST_NOEX override {
-    if (!left || !right) return NAN;
-    return p_operation.operation(left->eval(), right->eval());
-  }
-};
+  /**
+   * @brief Evaluates the expression rooted at `root`.
+   *
+   * Every node up to `root` is computed in index order.
+   *
+   * @param slots The value of every variable, indexed by slot.
+   * @param values Scratch space, reused between calls to avoid allocating.
+   */
+  double eval(NodeId root, const double *slots,
+              std::vector<double> &values) const;
 
-class Add : public BinaryOperator {
- public:
-  Add() : BinaryOperator({'+', [&](double a, double b) { return a + b; }}) {}
-};
+  /**
+   * @brief Emits bytecode for the expression rooted at `root`.
+   *
+   * A node reached more than once is computed the first time, kept in a
+   * temporary and loaded from there afterwards.
+   *
+   * @return The instructions, ready for `Program::assemble()`.
+   */
+  std::vector<Tokenizer::Instruction> lower(NodeId root) const;
 
-class Subtract : public BinaryOperator {
- public:
-  Subtract()
-      : BinaryOperator({'-', [&](double a, double b) { return a - b; }}) {}
-};
-class Divide : public BinaryOperator {
- public:
-  Divide()
-      : BinaryOperator({'/', [&](double a, double b) {
-                          assert(b != 0);
-                          return a / b;
-                        }}) {}
-};
-class Multiply : public BinaryOperator {
- public:
-  Multiply()
-      : BinaryOperator({'*', [&](double a, double b) { return a * b; }}) {}
-};
+  /**
+   * @brief Writes the expression rooted at `root` in infix form.
+   * @param variables Variable name for every slot.
+   */
+  std::string format(NodeId root, const std::vector<std::string> &variables) const;
 
-class Negate : public TreeNode {
- public:
-  ValueNode *node{};
-  virtual void print() FNP_CST_NOEX override { fmt::print("{}", node->eval()); }
-  virtual double eval() FNP_CST_NOEX override { return -(node->eval()); }
+  const Node &operator[](NodeId id) const noexcept { return m_nodes[id]; }
+  std::size_t size() const noexcept { return m_nodes.size(); }
+  void reserve(std::size_t nodes) { m_nodes.reserve(nodes); }
+  /// Drops every node at once, keeping the memory for reuse.
+  void clear() noexcept { m_nodes.clear(); }
 
-  ~Negate() { delete node; }
+private:
+  std::vector<Node> m_nodes{};
 };
 
-};  // namespace types
+} // namespace types
@@ -0,0 +1,245 @@
+// Headless evaluator: samples an expression and streams the points to
+// stdout or a file, without opening a window.
+//
+//   fncxx_eval [options] <expression>
+//     --from A, --to B    x-range, default [-10, 10]
+//     --samples N         uniform intervals, default 1000
+//     --tolerance T       sample adaptively instead, to within T in y,
+//                         starting from the given number of intervals
+//     --max-evals N       evaluation budget of adaptive sampling
+//     --format csv|binary output format, default csv
+//     --output FILE       write to FILE instead of stdout
+//     --threads N         evaluator threads; 0 uses every core
+//     --jit               evaluate with the native backend
+//
+// CSV output is one `x,y` line per point, each number in its shortest
+// round-trip form. Binary output is the same points as consecutive pairs
+// of little-endian IEEE 754 doubles, x then y, with no header. Undefined
+// values are written as NaN; adaptive output also uses a NaN y to break
+// the curve at a pole.
+#include "../Grapher/Sampling.hpp"
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Points produced and written at a time by uniform sampling.
+constexpr std::size_t kChunkPoints = 1 << 16;
+
+enum class Format { Csv, Binary };
+
+struct Options {
+  std::string expression{};
+  double from{-10};
+  double to{10};
+  std::size_t samples{1000};
+  double tolerance{0}; ///< Adaptive sampling if positive
+  std::size_t maxEvaluations{1 << 20};
+  Format format{Format::Csv};
+  std::string output{};
+};
+
+/// Writes points in the chosen format through one reused buffer.
+class PointWriter {
+public:
+  PointWriter(std::FILE *file, Format format)
+      : m_file(file), m_format(format) {}
+
+  /// Encodes the points into the buffer and writes it in one call.
+  bool write(std::span<const double> xs, std::span<const double> ys) {
+    if (m_format == Format::Binary) {
+      m_binary.resize(2 * xs.size());
+      for (std::size_t i = 0; i < xs.size(); ++i) {
+        m_binary[2 * i] = toLittleEndian(xs[i]);
+        m_binary[2 * i + 1] = toLittleEndian(ys[i]);
+      }
+      return std::fwrite(m_binary.data(), sizeof(std::uint64_t),
+                         m_binary.size(), m_file) == m_binary.size();
+    }
+    m_text.clear();
+    for (std::size_t i = 0; i < xs.size(); ++i)
+      fmt::format_to(std::back_inserter(m_text), "{},{}\n", xs[i], ys[i]);
+    return std::fwrite(m_text.data(), 1, m_text.size(), m_file) ==
+           m_text.size();
+  }
+
+private:
+  static std::uint64_t toLittleEndian(double value) {
+    auto bits = std::bit_cast<std::uint64_t>(value);
+    if constexpr (std::endian::native == std::endian::big) {
+      std::uint64_t swapped = 0;
+      for (int i = 0; i < 8; ++i, bits >>= 8)
+        swapped = swapped << 8 | (bits & 0xff);
+      bits = swapped;
+    }
+    return bits;
+  }
+
+  std::FILE *m_file;
+  Format m_format;
+  std::vector<std::uint64_t> m_binary{};
+  fmt::memory_buffer m_text{};
+};
+
+// Evaluates `samples` equal intervals a chunk at a time, each chunk split
+// across the pool, and writes every chunk as soon as it is done.
+bool writeUniform(const Tokenizer::CompiledExpression &expr,
+                  const Options &options, PointWriter &writer) {
+  auto &pool = Tokenizer::ThreadPool::shared();
+  const std::size_t points = options.samples + 1;
+  const double step =
+      (options.to - options.from) / static_cast<double>(options.samples);
+  std::vector<double> xs(std::min(points, kChunkPoints));
+  std::vector<double> ys(xs.size());
+  for (std::size_t base = 0; base < points; base += xs.size()) {
+    const std::size_t n = std::min(xs.size(), points - base);
+    for (std::size_t i = 0; i < n; ++i)
+      xs[i] = options.from + static_cast<double>(base + i) * step;
+    pool.parallelFor(n, Tokenizer::CompiledExpression::kBatchSize,
+                     [&](std::size_t begin, std::size_t end) {
+                       expr.evalBatch({xs.data() + begin, end - begin},
+                                      {ys.data() + begin, end - begin});
+                     });
+    if (!writer.write({xs.data(), n}, {ys.data(), n}))
+      return false;
+  }
+  return true;
+}
+
+// Samples adaptively with `samples` starting intervals. Pixels are mapped
+// so that one pixel is `tolerance` tall and nothing is ever off screen.
+bool writeAdaptive(const Tokenizer::CompiledExpression &expr,
+                   const Options &options, PointWriter &writer) {
+  Sampling::AdaptiveSettings settings{};
+  settings.tolerancePx = 1;
+  settings.initialSpacingPx = 1;
+  settings.maxEvaluations = options.maxEvaluations;
+  Sampling::Viewport view{};
+  view.xMin = options.from;
+  view.xMax = options.to;
+  view.yMin = -std::numeric_limits<double>::infinity();
+  view.yMax = std::numeric_limits<double>::infinity();
+  view.pixelsPerUnitX =
+      static_cast<double>(options.samples) / (options.to - options.from);
+  view.pixelsPerUnitY = 1 / options.tolerance;
+
+  std::vector<Sampling::Point> points{};
+  Sampling::sampleAdaptive(expr, view, settings, points);
+  std::vector<double> xs{}, ys{};
+  for (std::size_t base = 0; base < points.size(); base += kChunkPoints) {
+    const std::size_t n = std::min(kChunkPoints, points.size() - base);
+    xs.resize(n);
+    ys.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      xs[i] = points[base + i].x;
+      ys[i] = points[base + i].y;
+    }
+    if (!writer.write(xs, ys))
+      return false;
+  }
+  return true;
+}
+
+void usage() {
+  std::fputs("usage: fncxx_eval [--from A] [--to B] [--samples N] "
+             "[--tolerance T] [--max-evals N]\n"
+             "                  [--format csv|binary] [--output FILE] "
+             "[--threads N] [--jit] <expression>\n",
+             stderr);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options{};
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::runtime_error("Missing value for " + arg);
+        return argv[++i];
+      };
+      if (arg == "--from") {
+        options.from = std::stod(value());
+      } else if (arg == "--to") {
+        options.to = std::stod(value());
+      } else if (arg == "--samples") {
+        options.samples = std::stoul(value());
+      } else if (arg == "--tolerance") {
+        options.tolerance = std::stod(value());
+      } else if (arg == "--max-evals") {
+        options.maxEvaluations = std::stoul(value());
+      } else if (arg == "--format") {
+        const std::string format = value();
+        if (format == "csv")
+          options.format = Format::Csv;
+        else if (format == "binary")
+          options.format = Format::Binary;
+        else
+          throw std::runtime_error("Unknown format " + format);
+      } else if (arg == "--output") {
+        options.output = value();
+      } else if (arg == "--threads") {
+        Tokenizer::ThreadPool::setSharedThreadCount(std::stoul(value()));
+      } else if (arg == "--jit") {
+        Tokenizer::CompiledExpression::setDefaultBackend(
+            Tokenizer::CompiledExpression::Backend::Jit);
+      } else if (options.expression.empty()) {
+        options.expression = arg;
+      } else {
+        throw std::runtime_error("Unexpected argument " + arg);
+      }
+    }
+    if (options.expression.empty() || options.samples == 0 ||
+        !(options.from < options.to))
+      throw std::runtime_error("Nothing to sample");
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    usage();
+    return 2;
+  }
+
+  try {
+    const Tokenizer::CompiledExpression expr(options.expression);
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(nullptr, std::fclose);
+    std::FILE *out = stdout;
+    if (!options.output.empty()) {
+      file.reset(std::fopen(options.output.c_str(), "wb"));
+      if (!file)
+        throw std::runtime_error("Cannot open " + options.output + ": " +
+                                 std::strerror(errno));
+      out = file.get();
+    }
+    // Every chunk goes out in a few large writes.
+    std::setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    PointWriter writer(out, options.format);
+    const bool written = options.tolerance > 0
+                             ? writeAdaptive(expr, options, writer)
+                             : writeUniform(expr, options, writer);
+    if (!written || std::fflush(out) != 0)
+      throw std::runtime_error("Write failed");
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
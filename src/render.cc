@@ -0,0 +1,218 @@
+// Headless renderer: draws the picture the grapher window shows into a PNG
+// or PPM file, without SFML or a display.
+//
+//   fncxx_render [options] <expression>...
+//   fncxx_render [options] --batch FILE
+//     --size WxH           image size, default 1200x900
+//     --view X0 X1 Y0 Y1   visible region, default [-15, 15] x [-11.25, 11.25]
+//     --adaptive           sample y = f(x) adaptively, as F2 does
+//     --features           mark zeros, extrema and intersections, as F3 does
+//     --param NAME=VALUE   value of a parameter, default 1
+//     --output FILE        default plot.png; a name ending in .ppm writes PPM
+//     --batch FILE         render one plot per line of FILE instead
+//     --threads N          render threads; 0 uses every core
+//     --jit                evaluate with the native backend
+//
+// Expressions take the same forms as in the window. A batch file holds one
+// plot per line: the output file, then its expressions separated by ';'.
+// Blank lines and lines starting with '#' are skipped. Every plot of a
+// batch is drawn on one thread and the plots run side by side; a single
+// plot is split into bands of rows across the threads instead.
+#include "../Grapher/Curves.hpp"
+#include "../Grapher/ImageFile.hpp"
+#include "../Grapher/Raster.hpp"
+#include "../functionParser/CompiledExpression.hpp"
+#include "../functionParser/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Options {
+  Raster::PlotSettings plot{};
+  std::vector<std::pair<std::string, double>> parameters{};
+  std::vector<std::string> expressions{};
+  std::string output{"plot.png"};
+  std::string batch{};
+};
+
+struct Job {
+  std::string output{};
+  std::vector<std::string> expressions{};
+  std::size_t line{}; ///< In the batch file, or 0
+};
+
+/// Compiles, draws and writes one plot; throws on any failure.
+void render(const Job &job, const Options &options, Raster::Canvas &canvas,
+            Raster::Image &image, Tokenizer::ThreadPool *pool) {
+  Sampling::CurveList list = Sampling::compileCurves(job.expressions);
+  for (auto &curve : list.curves)
+    for (auto &expression : curve.expressions)
+      for (const auto &[name, value] : options.parameters)
+        expression.setVariable(name, value);
+
+  canvas.clear();
+  Raster::drawPlot(list, options.plot, canvas, pool);
+  image.resize(options.plot.width, options.plot.height);
+  image.fill({255, 255, 255});
+  canvas.render(image, pool);
+  if (!Raster::writeImage(image, job.output))
+    throw std::runtime_error("Cannot write " + job.output);
+}
+
+std::vector<Job> readBatch(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("Cannot open " + path);
+  std::vector<Job> jobs{};
+  std::string text{};
+  for (std::size_t line = 1; std::getline(in, text); ++line) {
+    const auto start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos || text[start] == '#')
+      continue;
+    const auto end = text.find_first_of(" \t", start);
+    Job job{};
+    job.line = line;
+    job.output = text.substr(start, end - start);
+    std::string rest = end == std::string::npos ? "" : text.substr(end);
+    for (std::size_t from = 0; from <= rest.size();) {
+      const auto semicolon = std::min(rest.find(';', from), rest.size());
+      const std::string expression = rest.substr(from, semicolon - from);
+      if (expression.find_first_not_of(" \t\r") != std::string::npos)
+        job.expressions.push_back(expression);
+      from = semicolon + 1;
+    }
+    if (job.expressions.empty())
+      throw std::runtime_error(path + ":" + std::to_string(line) +
+                               ": no expressions");
+    jobs.push_back(std::move(job));
+  }
+  return jobs;
+}
+
+void usage() {
+  std::fputs("usage: fncxx_render [--size WxH] [--view X0 X1 Y0 Y1] "
+             "[--adaptive] [--features]\n"
+             "                    [--param NAME=VALUE] [--output FILE] "
+             "[--threads N] [--jit]\n"
+             "                    <expression>... | --batch FILE\n",
+             stderr);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options{};
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::runtime_error("Missing value for " + arg);
+        return argv[++i];
+      };
+      if (arg == "--size") {
+        const std::string size = value();
+        const auto x = size.find('x');
+        if (x == std::string::npos)
+          throw std::runtime_error("Expected WxH, got " + size);
+        options.plot.width = std::stoul(size.substr(0, x));
+        options.plot.height = std::stoul(size.substr(x + 1));
+      } else if (arg == "--view") {
+        options.plot.xMin = std::stod(value());
+        options.plot.xMax = std::stod(value());
+        options.plot.yMin = std::stod(value());
+        options.plot.yMax = std::stod(value());
+      } else if (arg == "--adaptive") {
+        options.plot.adaptive = true;
+      } else if (arg == "--features") {
+        options.plot.features = true;
+      } else if (arg == "--param") {
+        const std::string param = value();
+        const auto equals = param.find('=');
+        if (equals == std::string::npos)
+          throw std::runtime_error("Expected NAME=VALUE, got " + param);
+        options.parameters.emplace_back(param.substr(0, equals),
+                                        std::stod(param.substr(equals + 1)));
+      } else if (arg == "--output") {
+        options.output = value();
+      } else if (arg == "--batch") {
+        options.batch = value();
+      } else if (arg == "--threads") {
+        Tokenizer::ThreadPool::setSharedThreadCount(std::stoul(value()));
+      } else if (arg == "--jit") {
+        Tokenizer::CompiledExpression::setDefaultBackend(
+            Tokenizer::CompiledExpression::Backend::Jit);
+      } else {
+        options.expressions.push_back(arg);
+      }
+    }
+    if (options.batch.empty() == options.expressions.empty())
+      throw std::runtime_error("Give either expressions or --batch");
+    if (options.plot.width == 0 || options.plot.height == 0 ||
+        !(options.plot.xMin < options.plot.xMax) ||
+        !(options.plot.yMin < options.plot.yMax))
+      throw std::runtime_error("Nothing to draw");
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    usage();
+    return 2;
+  }
+
+  auto &pool = Tokenizer::ThreadPool::shared();
+  if (options.batch.empty()) {
+    try {
+      Raster::Canvas canvas{};
+      Raster::Image image{};
+      render({options.output, options.expressions}, options, canvas, image,
+             &pool);
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+    return 0;
+  }
+
+  std::vector<Job> jobs{};
+  try {
+    jobs = readBatch(options.batch);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  // Plots are independent, so each thread draws whole plots; the calls the
+  // drawing makes into the pool run inline on that thread.
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<std::size_t> failed{0};
+  std::mutex errors{};
+  pool.parallelFor(jobs.size(), 1, [&](std::size_t begin, std::size_t end) {
+    Raster::Canvas canvas{};
+    Raster::Image image{};
+    for (std::size_t j = begin; j < end; ++j) {
+      try {
+        render(jobs[j], options, canvas, image, &pool);
+      } catch (const std::exception &e) {
+        ++failed;
+        std::lock_guard lock(errors);
+        std::fprintf(stderr, "%s:%zu: %s\n", options.batch.c_str(),
+                     jobs[j].line, e.what());
+      }
+    }
+  });
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::fprintf(stderr, "Rendered %zu of %zu plots in %.2f s\n",
+               jobs.size() - failed, jobs.size(), elapsed.count());
+  return failed == 0 ? 0 : 1;
+}